@@ -65,6 +65,77 @@ class Container:
         self.fname = fname
         self.a = a
 
+def read_energies_binary(fname):
+    """
+    Read a binary energy file written by VMC::stream_energies_to_file.
+    See EnergyWriter in src/energy_writer.h for the format.
+
+    Parameters
+    ----------
+    fname : string
+        Path to the binary energy file.
+
+    Returns
+    -------
+    header : dictionary
+        Run metadata from the file header. Values are strings.
+
+    alphas : numpy.ndarray
+        Variational parameter of each variation.
+
+    energies : numpy.ndarray
+        Local energy of every sampled cycle, one column per variation.
+        The cycles of walker 0 come first, then walker 1, and so on.
+        Columns with fewer cycles than the longest are padded with NaN.
+    """
+    with open(fname, "rb") as infile:
+        content = infile.read()
+
+    if content[:8] != b"VMCENRG1":
+        raise ValueError(f"{fname} is not a binary energy file.")
+
+    header_length = int.from_bytes(content[8:12], byteorder="little")
+    if header_length > len(content):
+        header_length = int.from_bytes(content[8:12], byteorder="big")
+    header_text = content[12:12 + header_length].decode()
+    header = dict(line.split("=", 1) for line in header_text.splitlines())
+
+    endian = "<" if header["byte_order"] == "little" else ">"
+    value_type = np.dtype(endian + ("f4" if header["value_bytes"] == "4" else "f8"))
+    chunk_type = np.dtype([
+        ("variation", endian + "i4"),
+        ("walker", endian + "i4"),
+        ("alpha", endian + "f8"),
+        ("first_cycle", endian + "i8"),
+        ("n_values", endian + "i8")
+    ])
+
+    chunks = {}     # (variation, walker, first_cycle) -> values.
+    alphas = {}
+    position = 12 + header_length
+    while position < len(content):
+        chunk = np.frombuffer(content, dtype=chunk_type, count=1, offset=position)[0]
+        position += chunk_type.itemsize
+        n_values = int(chunk["n_values"])
+        values = np.frombuffer(content, dtype=value_type, count=n_values, offset=position)
+        position += n_values*value_type.itemsize
+
+        variation = int(chunk["variation"])
+        alphas[variation] = float(chunk["alpha"])
+        chunks[(variation, int(chunk["walker"]), int(chunk["first_cycle"]))] = values
+
+    variations = sorted(alphas)
+    columns = []
+    for variation in variations:
+        keys = sorted(key for key in chunks if key[0] == variation)
+        columns.append(np.concatenate([chunks[key] for key in keys]).astype(np.float64))
+
+    energies = np.full((max(len(column) for column in columns), len(columns)), np.nan)
+    for i, column in enumerate(columns):
+        energies[:len(column), i] = column
+
+    return header, np.array([alphas[variation] for variation in variations]), energies
+
 def read_all_files(
     filter_method = None,
     filter_n_particles = None,
@@ -230,7 +301,15 @@ def read_all_files(
         if (filter_a != a) and (filter_a is not None) and (a is not None):
             continue
 
-        data = np.loadtxt(fname = directory + fnames[i], skiprows=1)
+        if fnames[i].endswith(".bin"):
+            """
+            Binary energy file. Same layout as the text files: alphas
+            in the first row, then the energies.
+            """
+            _, alphas, energies = read_energies_binary(directory + fnames[i])
+            data = np.vstack((alphas, energies))
+        else:
+            data = np.loadtxt(fname = directory + fnames[i], skiprows=1)
 
         data_list.append(Container(
             data,
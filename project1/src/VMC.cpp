@@ -1,4 +1,6 @@
 #include "VMC.h"
+#include "checkpoint.h"
+#include "distributed.h"
 
 VMC::VMC(
     const int n_dims_input,
@@ -12,6 +14,7 @@ VMC::VMC(
 ) : n_dims(n_dims_input),
     n_variations(n_variations_input),
     n_mc_cycles(n_mc_cycles_input),
+    chunk_cycles(n_mc_cycles_input),
     n_particles(n_particles_input),
     beta(beta_input)
 
@@ -38,25 +41,35 @@ VMC::VMC(
     debug_input : boolean
         For toggling debug print on / off.
     */
-    pos_new = arma::Mat<double>(n_dims, n_particles);         // Proposed new position.
-    pos_current = arma::Mat<double>(n_dims, n_particles);     // Current position.
     e_variances = arma::Col<double>(n_variations);            // Energy variances.
     e_expectations = arma::Col<double>(n_variations);         // Energy expectation values.
-    qforce_current = arma::Mat<double>(n_dims, n_particles);  // Current quantum force.
-    qforce_new = arma::Mat<double>(n_dims, n_particles);      // New quantum force.
-    test_local = arma::Row<double>(n_mc_cycles);              // Temporary
-    energies = arma::Mat<double>(n_mc_cycles, n_variations);
+    e_errors = arma::Col<double>(n_variations);               // Blocking errors.
     alphas = alphas_input;
+    betas = arma::Col<double>(n_variations);
+    betas.fill(beta_input);
+    wave_derivative_expectation = arma::Col<double>(n_wave_parameters);
+    wave_times_energy_expectation = arma::Col<double>(n_wave_parameters);
+    wave_derivative_products_expectation = arma::Mat<double>(n_wave_parameters, n_wave_parameters);
+    variance_gradient = arma::Col<double>(n_wave_parameters);
+    variance_gradient.zeros();
     n_variations_final = n_variations;  // If stop condition is not reached.
     numerical_differentiation = numerical_differentiation_input;
     debug = debug_input;                // For toggling debug print on / off.
 
     acceptances = arma::Col<double>(n_variations);   // Debug.
     acceptances.zeros();
+    cycles = arma::Col<double>(n_variations);
+    cycles.fill(n_mc_cycles);
+    burn_in_cycles = arma::Col<double>(n_variations);
+    burn_in_cycles.zeros();
+    reference_variations = arma::Col<double>(n_variations);
+    for (int variation = 0; variation < n_variations; variation++)
+    {
+        reference_variations(variation) = variation;
+    }
 
     e_expectations.zeros(); // Array must be zeroed since values will be added to it.
-    energies.zeros();
-    engine.seed(seed);
+    e_errors.zeros();
 
     timing = arma::Col<double>(n_variations);
     timing.zeros();
@@ -67,44 +80,591 @@ VMC::VMC(
     bin_locations = arma::linspace(0, r_bins_end - r_bins_end/n_bins, n_bins + 1);
     particle_per_bin_count = arma::Mat<double>(n_bins, n_variations);
     particle_per_bin_count.zeros();
-    particle_per_bin_count_thread = arma::Col<double>(n_bins);
-    particle_per_bin_count_thread.zeros();
     // One-body density parameters end.
+
+    #ifdef _OPENMP
+        n_threads = omp_get_max_threads();
+    #else
+        n_threads = 1;
+    #endif
+    allocate_walkers(n_threads*distributed_size());    // One walker per thread by default.
 }
 
 void VMC::set_seed(double seed_input)
+{   /*
+    Set the RNG seed. Walker 'i' draws from stream 'i' of the Philox
+    generator keyed with this seed.
+    */
+    seed = static_cast<std::uint64_t>(seed_input);
+}
+
+void VMC::set_walkers_per_thread(const int walkers_per_thread_input)
+{   /*
+    Set the number of independent walkers run by each thread. The
+    n_mc_cycles sampled cycles are divided evenly between all walkers.
+    Note that the total number of walkers, and thus the result, then
+    depends on the number of threads and ranks.  Use set_n_walkers for results
+    which are reproducible for any number of threads.
+
+    Parameters
+    ----------
+    walkers_per_thread_input : constant integer
+        Number of walkers per thread.
+    */
+    const int n_walkers_input = n_threads*walkers_per_thread_input*distributed_size();
+    check_n_walkers(n_walkers_input);
+    allocate_walkers(n_walkers_input);
+}
+
+void VMC::set_n_walkers(const int n_walkers_input)
+{   /*
+    Set the total number of independent walkers, regardless of the
+    number of threads.  Since every walker has its own RNG stream, a run
+    with a given seed and number of walkers gives bit-identical results
+    for any number of threads and ranks.
+
+    Parameters
+    ----------
+    n_walkers_input : constant integer
+        Total number of walkers.
+    */
+    check_n_walkers(n_walkers_input);
+    allocate_walkers(n_walkers_input);
+}
+
+void VMC::set_burn_in(const int n_burn_in_cycles_input)
+{   /*
+    Set the number of MC cycles each walker runs before sampling starts.
+
+    Parameters
+    ----------
+    n_burn_in_cycles_input : constant integer
+        Number of discarded MC cycles per walker.
+    */
+    n_burn_in_cycles = n_burn_in_cycles_input;
+}
+
+void VMC::set_auto_burn_in(const int burn_in_window_input, const int max_burn_in_cycles_input)
+{   /*
+    After the n_burn_in_cycles of set_burn_in, continue the burn-in in
+    windows of 'burn_in_window_input' cycles until the mean local
+    energy of a window agrees with the mean of the previous window, see
+    VMC::burn_in.  The number of burn-in cycles is then chosen per
+    walker, and is written to file next to the number of sampled
+    cycles.
+
+    Parameters
+    ----------
+    burn_in_window_input : constant integer
+        Cycles per window. 0 turns the automatic burn-in off.
+
+    max_burn_in_cycles_input : constant integer
+        Maximum number of burn-in cycles per walker.
+    */
+    burn_in_window = burn_in_window_input;
+    max_burn_in_cycles = max_burn_in_cycles_input;
+}
+
+void VMC::set_target_error(const double target_error_input, const long max_cycles_input)
+{   /*
+    Run every variation in chunks of n_mc_cycles cycles until the
+    blocking estimate of the standard error of the energy is below
+    'target_error_input', instead of exactly n_mc_cycles cycles.  The
+    walkers continue their chains between chunks, so burn-in is only
+    done once per variation.
+
+    Parameters
+    ----------
+    target_error_input : constant double
+        Target standard error of the energy. 0 turns the mode off.
+
+    max_cycles_input : constant long
+        Maximum number of sampled MC cycles per variation.
+    */
+    target_error = target_error_input;
+    max_cycles = max_cycles_input;
+}
+
+void VMC::set_reweighting(const double min_ess_fraction_input)
+{   /*
+    Turn on correlated sampling for alpha scans.  The chain of a
+    reference variation also estimates the energy of every following
+    alpha, by weighting its configurations with |psi_alpha/psi_ref|^2,
+    see VMC::reweight_cycle.  Those variations are not sampled as long
+    as the effective sample size of the weights is at least
+    'min_ess_fraction_input' of the sampled cycles.  The first variation
+    below the threshold gets a new reference chain.  Call before
+    restart.
+
+    Parameters
+    ----------
+    min_ess_fraction_input : constant double
+        Minimum effective sample size fraction, e.g. 0.5. 0 turns the
+        mode off.
+    */
+    min_ess_fraction = min_ess_fraction_input;
+}
+
+void VMC::set_distributed(const bool distributed_input)
+{   /*
+    Toggle the division of the walkers between the ranks of a
+    distributed run on / off.  Off runs all walkers on the calling rank,
+    e.g. for the independent points of a Sweep.  Call before
+    set_n_walkers.
+    */
+    distributed = distributed_input;
+    allocate_walkers(n_walkers);
+}
+
+void VMC::set_verbose(const bool verbose_input)
+{   /*
+    Toggle the print of every variation in solve on / off.
+    */
+    verbose = verbose_input;
+}
+
+double VMC::get_energy(const int variation) const
+{   /*
+    Energy expectation value of 'variation'. Valid after solve.
+    */
+    return e_expectations(variation);
+}
+
+double VMC::get_energy_variance(const int variation) const
 {
-    seed = seed_input;
-    engine.seed(seed);
+    return e_variances(variation);
 }
 
-void VMC::set_quantum_force(bool interaction)
+double VMC::get_energy_error(const int variation) const
+{   /*
+    Blocking estimate of the standard error of the energy.
+    */
+    return e_errors(variation);
+}
+
+double VMC::get_acceptance_rate(const int variation) const
+{
+    return acceptances(variation)/(cycles(variation)*n_particles);
+}
+
+double VMC::get_time(const int variation) const
 {
-    if ((n_dims == 1) and !interaction)
+    return timing(variation);
+}
+
+double VMC::get_burn_in_cycles(const int variation) const
+{   /*
+    Discarded MC cycles of all walkers.
+    */
+    return burn_in_cycles(variation);
+}
+
+void VMC::set_checkpoint(std::string fpath, const double interval)
+{   /*
+    Write checkpoints to 'fpath' during solve, at the end of a variation
+    or of a chunk of cycles (see set_target_error), but at most once
+    every 'interval' seconds.  A checkpoint is first written to a
+    temporary file and then renamed, so an interrupted write leaves the
+    previous checkpoint intact.
+
+    Parameters
+    ----------
+    fpath : std::string
+        Relative file path and name.
+
+    interval : constant double
+        Minimum wall time in seconds between checkpoints.
+    */
+    checkpoint_fpath = fpath;
+    checkpoint_interval = interval;
+    checkpoint_time = std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void VMC::checkpoint(const int variation, const int chunk, const long n_cycles_total)
+{   /*
+    Write a checkpoint if checkpoints are on and the interval has
+    passed.  The run then continues at chunk 'chunk' of variation
+    'variation'.  For chunk 0 the walker states are not needed, since
+    every variation starts by seeding and initializing the walkers.
+
+    Parameters
+    ----------
+    variation : constant integer
+        Variation to resume.
+
+    chunk : constant integer
+        Chunk to resume.
+
+    n_cycles_total : constant long
+        Cycles sampled in the chunks before 'chunk'.
+    */
+    if (checkpoint_fpath.empty()) return;
+
+    const double now = std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    double write = now - checkpoint_time >= checkpoint_interval;
+    if (distributed) distributed_broadcast(write);  // Every rank writes the same checkpoint.
+    if (!write) return;
+
+    const std::string fpath_rank = checkpoint_rank_fpath(checkpoint_fpath);
+    const std::string fpath_tmp = fpath_rank + ".tmp";
+    std::ofstream checkpoint_file(fpath_tmp, std::ios::out | std::ios::binary);
+    checkpoint_file.write("VMCCHKP1", 8);
+
+    // Configuration, checked by restart.
+    write_raw(checkpoint_file, n_particles);
+    write_raw(checkpoint_file, n_dims);
+    write_raw(checkpoint_file, n_walkers);
+    write_raw(checkpoint_file, distributed_size());
+    write_raw(checkpoint_file, n_variations);
+    write_raw(checkpoint_file, n_mc_cycles);
+    write_raw(checkpoint_file, seed);
+
+    // Progress and results so far.
+    write_raw(checkpoint_file, variation);
+    write_raw(checkpoint_file, chunk);
+    write_raw(checkpoint_file, n_cycles_total);
+    write_raw(checkpoint_file, n_variations_final);
+    write_matrix(checkpoint_file, alphas);
+    write_matrix(checkpoint_file, betas);
+    write_matrix(checkpoint_file, e_expectations);
+    write_matrix(checkpoint_file, e_variances);
+    write_matrix(checkpoint_file, e_errors);
+    write_matrix(checkpoint_file, cycles);
+    write_matrix(checkpoint_file, burn_in_cycles);
+    write_matrix(checkpoint_file, reference_variations);
+    write_matrix(checkpoint_file, acceptances);
+    write_matrix(checkpoint_file, timing);
+    write_matrix(checkpoint_file, particle_per_bin_count);
+    save_state(checkpoint_file);
+
+    if (chunk > 0)
     {
-        quantum_force_ptr = &quantum_force_3d_no_interaction;   // NB!! This might be wrong!
+        for (const Walker &walker : walkers) walker.save(checkpoint_file);
     }
-    else if ((n_dims == 2) and !interaction)
+
+    checkpoint_file.close();
+    if (!checkpoint_file or (std::rename(fpath_tmp.c_str(), fpath_rank.c_str()) != 0))
     {
-        quantum_force_ptr = &quantum_force_3d_no_interaction;   // NB!! This might be wrong!
+        std::cout << "Could not write checkpoint " << fpath_rank << "!" << std::endl;
+        return;
     }
-    else if ((n_dims == 3) and !interaction)
+    checkpoint_time = now;
+    if (debug)
     {
-        quantum_force_ptr = &quantum_force_3d_no_interaction;
+        std::cout << "Checkpoint written: variation " << variation;
+        std::cout << ", chunk " << chunk << "." << std::endl;
     }
-    else if ((n_dims == 1) and interaction)
+}
+
+void VMC::restart(std::string fpath)
+{   /*
+    Load a checkpoint written by set_checkpoint, so that solve continues
+    where the checkpointed run stopped, with bit-identical results.
+    Must be called after the walkers, seed and target error are set as
+    in the original run.  Energy sinks only receive the energies of the
+    resumed part of the run.
+
+    Parameters
+    ----------
+    fpath : std::string
+        Relative file path and name.
+    */
+    fpath = checkpoint_rank_fpath(fpath);
+    std::ifstream checkpoint_file(fpath, std::ios::in | std::ios::binary);
+    char magic[8];
+    checkpoint_file.read(magic, 8);
+    if (!checkpoint_file or (std::string(magic, 8) != "VMCCHKP1"))
     {
-        not_implemented_error("quantum force", interaction);
+        std::cout << fpath << " is not a checkpoint! Exiting..." << std::endl;
+        exit(0);
     }
-    else if ((n_dims == 2) and interaction)
+
+    int n_particles_file, n_dims_file, n_walkers_file, n_ranks_file, n_variations_file, n_mc_cycles_file;
+    std::uint64_t seed_file;
+    read_raw(checkpoint_file, n_particles_file);
+    read_raw(checkpoint_file, n_dims_file);
+    read_raw(checkpoint_file, n_walkers_file);
+    read_raw(checkpoint_file, n_ranks_file);
+    read_raw(checkpoint_file, n_variations_file);
+    read_raw(checkpoint_file, n_mc_cycles_file);
+    read_raw(checkpoint_file, seed_file);
+    if (
+        (n_particles_file != n_particles) or (n_dims_file != n_dims) or
+        (n_walkers_file != n_walkers) or (n_ranks_file != distributed_size()) or
+        (n_variations_file != n_variations) or
+        (n_mc_cycles_file != n_mc_cycles)
+    )
     {
-        not_implemented_error("quantum force", interaction);
+        std::cout << "Checkpoint " << fpath << " is from a different configuration! Exiting..." << std::endl;
+        exit(0);
     }
-    else if ((n_dims == 3) and interaction)
+    seed = seed_file;
+
+    read_raw(checkpoint_file, restart_variation);
+    read_raw(checkpoint_file, restart_chunk);
+    read_raw(checkpoint_file, restart_cycles);
+    read_raw(checkpoint_file, n_variations_final);
+    read_matrix(checkpoint_file, alphas);
+    read_matrix(checkpoint_file, betas);
+    read_matrix(checkpoint_file, e_expectations);
+    read_matrix(checkpoint_file, e_variances);
+    read_matrix(checkpoint_file, e_errors);
+    read_matrix(checkpoint_file, cycles);
+    read_matrix(checkpoint_file, burn_in_cycles);
+    read_matrix(checkpoint_file, reference_variations);
+    read_matrix(checkpoint_file, acceptances);
+    read_matrix(checkpoint_file, timing);
+    read_matrix(checkpoint_file, particle_per_bin_count);
+    load_state(checkpoint_file);
+
+    if (restart_chunk > 0)
     {
-        quantum_force_ptr = &quantum_force_3d_interaction;
+        set_reweight_alphas(restart_variation);
+        for (Walker &walker : walkers) walker.load(checkpoint_file);
     }
-    else
+
+    if (!checkpoint_file)
+    {
+        std::cout << "Could not read checkpoint " << fpath << "! Exiting..." << std::endl;
+        exit(0);
+    }
+    restarting = true;
+    if (distributed_root())
+    {
+        std::cout << "Restarting from " << fpath << " at variation " << restart_variation;
+        std::cout << ", chunk " << restart_chunk << "." << std::endl;
+    }
+}
+
+std::string VMC::checkpoint_rank_fpath(const std::string fpath)
+{   /*
+    Every rank writes the walkers it owns to its own checkpoint file.
+    The file of rank 0, or of a run without ranks, is 'fpath'.
+    */
+    if (!distributed or (distributed_rank() == 0)) return fpath;
+    return fpath + ".rank" + std::to_string(distributed_rank());
+}
+
+void VMC::save_state(std::ostream &outfile) const
+{   /*
+    Write state of a derived class to a checkpoint, e.g. the optimizer
+    of GradientDescent. Nothing by default.
+    */
+}
+
+void VMC::load_state(std::istream &infile)
+{   /*
+    Read the state written by save_state.
+    */
+}
+
+void VMC::set_reweight_alphas(const int variation)
+{   /*
+    Make the alphas after 'variation' the targets of its chain if
+    correlated sampling is on, see set_reweighting, and size the
+    correlated sampling sums of the walkers.
+    */
+    const int n_targets = (min_ess_fraction > 0) ? n_variations - variation - 1 : 0;
+    reweight_alphas = arma::Col<double>(n_targets);
+    for (int target = 0; target < n_targets; target++)
+    {
+        reweight_alphas(target) = alphas(variation + 1 + target);
+    }
+    for (Walker &walker : walkers)
+    {
+        walker.reweight_sums = arma::Mat<double>(5, n_targets);
+        walker.reweight_sums.zeros();
+    }
+}
+
+int VMC::reweight(const int reference)
+{   /*
+    Estimate the energy of the targets of the chain of variation
+    'reference' from the correlated sampling sums of the walkers, see
+    VMC::reweight_cycle.  The estimates are accepted in order until the
+    effective sample size (sum w)^2/(sum w^2) of a target drops below
+    min_ess_fraction of the sampled cycles.  The error of an accepted
+    target is the blocking error of the reference, scaled by the ratio
+    of the standard deviations and by sqrt(cycles/ESS).  The one-body
+    density is not reweighted.
+
+    Parameters
+    ----------
+    reference : constant integer
+        The variation which was just sampled.
+
+    Returns
+    -------
+    int
+        The next variation to sample, n_variations if none.
+    */
+    const int n_targets = reweight_alphas.n_elem;
+    const int n_sums = 5*n_targets;
+
+    // Correlated sampling sums of all ranks, one column per walker.
+    arma::Mat<double> walker_sums(n_sums, walkers.size());
+    for (std::size_t walker_index = 0; walker_index < walkers.size(); walker_index++)
+    {
+        for (int sum = 0; sum < n_sums; sum++)
+        {
+            walker_sums(sum, walker_index) = walkers[walker_index].reweight_sums(sum);
+        }
+    }
+    arma::Mat<double> all_walker_sums = walker_sums;
+    if (distributed)
+    {
+        all_walker_sums = arma::Mat<double>(n_sums, n_walkers);
+        distributed_all_gather(
+            walker_sums.memptr(),
+            all_walker_sums.memptr(),
+            n_sums*sizeof(double),
+            n_walkers
+        );
+    }
+
+    const double reference_variance = e_variances(reference);
+    for (int target = 0; target < n_targets; target++)
+    {
+        const int variation = reference + 1 + target;
+
+        // Bring the weights of all walkers to the largest shift.
+        double shift = -std::numeric_limits<double>::infinity();
+        for (arma::uword walker = 0; walker < all_walker_sums.n_cols; walker++)
+        {
+            if (all_walker_sums(5*target + 1, walker) == 0) continue;
+            shift = std::max(shift, all_walker_sums(5*target, walker));
+        }
+        double weight_sum = 0;
+        double weight_energy_sum = 0;
+        double weight_energy_squared_sum = 0;
+        double weight_squared_sum = 0;
+        for (arma::uword walker = 0; walker < all_walker_sums.n_cols; walker++)
+        {   /*
+            Sum the walker sums in a fixed order.
+            */
+            if (all_walker_sums(5*target + 1, walker) == 0) continue;
+            const double scale = std::exp(all_walker_sums(5*target, walker) - shift);
+            weight_sum += scale*all_walker_sums(5*target + 1, walker);
+            weight_energy_sum += scale*all_walker_sums(5*target + 2, walker);
+            weight_energy_squared_sum += scale*all_walker_sums(5*target + 3, walker);
+            weight_squared_sum += scale*scale*all_walker_sums(5*target + 4, walker);
+        }
+
+        const double ess = weight_sum*weight_sum/weight_squared_sum;
+        if (!(ess >= min_ess_fraction*cycles(reference)))
+        {
+            if (verbose)
+            {
+                std::cout << "alpha: " << std::setw(10) << alphas(variation);
+                std::cout << ", effective sample size fraction " << ess/cycles(reference);
+                std::cout << " too small, new reference chain." << std::endl;
+            }
+            return variation;
+        }
+
+        const double energy = weight_energy_sum/weight_sum;
+        const double variance = weight_energy_squared_sum/weight_sum - energy*energy;
+        e_expectations(variation) = energy;
+        e_variances(variation) = variance;
+        if (reference_variance > 0)
+        {
+            e_errors(variation) = e_errors(reference)*std::sqrt(variance/reference_variance)
+                *std::sqrt(cycles(reference)/ess);
+        }
+        else
+        {
+            e_errors(variation) = std::sqrt(std::max(variance, 0.0)/ess);
+        }
+        cycles(variation) = cycles(reference);
+        acceptances(variation) = acceptances(reference);
+        burn_in_cycles(variation) = 0;
+        timing(variation) = 0;
+        reference_variations(variation) = reference;
+        particle_per_bin_count.col(variation).zeros();
+
+        if (verbose)
+        {
+            std::cout << "variation : " << std::setw(3) <<  variation;
+            std::cout << ", alpha: " << std::setw(10) << alphas(variation);
+            std::cout << ", energy: " << std::setw(10) << energy;
+            std::cout << ", error: " << std::setw(10) << e_errors(variation);
+            std::cout << ", variance: " << std::setw(10) << variance;
+            std::cout << ", reweighted from variation " << reference;
+            std::cout << ", ess: " << std::setw(10) << ess/cycles(reference) << std::endl;
+        }
+    }
+    return n_variations;
+}
+
+void VMC::set_variance_gradient(const int n_parameters)
+{   /*
+    Toggle sampling of the gradient of the energy variance with respect
+    to the first 'n_parameters' wave function parameters on / off, see
+    variance_cycle.  Costs two extra local energy evaluations per
+    parameter and cycle.  0 turns it off.
+    */
+    n_variance_parameters = n_parameters;
+    for (Walker &walker : walkers)
+    {
+        walker.variance_sums = arma::Col<double>((n_variance_parameters > 0) ? 2 + 5*n_wave_parameters : 0);
+        walker.variance_sums.zeros();
+    }
+}
+
+int VMC::first_variation()
+{   /*
+    First variation of solve. 0, or the variation of the checkpoint
+    after restart.
+    */
+    return restarting ? restart_variation : 0;
+}
+
+void VMC::check_n_walkers(const int n_walkers_input)
+{   /*
+    Exit unless every walker gets at least two of the n_mc_cycles
+    cycles, which the blocking analysis of its chain needs.
+    */
+    if (2*n_walkers_input > n_mc_cycles)
+    {
+        std::cout << "Every walker needs at least 2 of the n_mc_cycles = " << n_mc_cycles;
+        std::cout << " cycles, but there are " << n_walkers_input << " walkers. Exiting..." << std::endl;
+        exit(0);
+    }
+}
+
+void VMC::allocate_walkers(const int n_walkers_input)
+{   /*
+    Create the walkers of this rank, out of 'n_walkers_input' walkers
+    of all ranks.
+    */
+    n_walkers = n_walkers_input;
+    int walker_begin = 0;
+    int walker_end = n_walkers;
+    if (distributed) distributed_range(n_walkers, walker_begin, walker_end);
+
+    walkers.clear();
+    walkers.reserve(walker_end - walker_begin);
+    for (int walker = walker_begin; walker < walker_end; walker++)
+    {
+        walkers.emplace_back(walker, n_dims, n_particles, n_bins, interaction);
+    }
+    set_variance_gradient(n_variance_parameters);
+}
+
+void VMC::set_quantum_force(bool interaction)
+{   /*
+    Check that a quantum force exists for the given dimensions and
+    interaction.  The kernel itself is selected at compile time by the
+    templated sampler, see VMC::quantum_force in sampler.h.
+
+    Parameters
+    ----------
+    interaction : boolean
+        Toggle interaction between particles on / off.
+    */
+    if ((n_dims < 1) or (n_dims > 3) or (interaction and (n_dims != 3)))
     {
         not_implemented_error("quantum force", interaction);
     }
@@ -121,9 +681,12 @@ void VMC::set_local_energy(bool interaction)
         Toggle interaction between particles on / off.
     */
 
+    local_energy_total_ptr = nullptr;   // Only set where a whole-configuration expression exists.
+    incremental_local_energy = false;   // Only set where an incremental update exists.
+
     if ((n_dims == 1) and !interaction and !numerical_differentiation)
     {
-        local_energy_ptr = &local_energy_1d_no_interaction;
+        local_energy_ptr = &local_energy_no_interaction<1>;
     }
     else if ((n_dims == 1) and !interaction and numerical_differentiation)
     {
@@ -135,7 +698,7 @@ void VMC::set_local_energy(bool interaction)
     }
     else if ((n_dims == 2) and !interaction and !numerical_differentiation)
     {
-        local_energy_ptr = &local_energy_2d_no_interaction;
+        local_energy_ptr = &local_energy_no_interaction<2>;
     }
     else if ((n_dims == 2) and !interaction and numerical_differentiation)
     {
@@ -147,11 +710,13 @@ void VMC::set_local_energy(bool interaction)
     }
     else if ((n_dims == 3) and !interaction and !numerical_differentiation)
     {
-        local_energy_ptr = &local_energy_3d_no_interaction;
+        local_energy_ptr = &local_energy_no_interaction<3>;
     }
     else if ((n_dims == 3) and interaction and !numerical_differentiation)
     {
         local_energy_ptr = &local_energy_3d_interaction;
+        local_energy_total_ptr = &local_energy_3d_interaction_total;
+        incremental_local_energy = true;
         // local_energy_ptr = &local_energy_3d_interaction_vala;
     }
     else if ((n_dims == 3) and !interaction and numerical_differentiation)
@@ -168,30 +733,25 @@ void VMC::set_local_energy(bool interaction)
 
 void VMC::set_wave_function(bool interaction)
 {   /*
-    Set pointers to the correct wave function exponent.
+    Check that a wave function exists for the given dimensions and
+    interaction, and size the distance caches. The wave function
+    log-ratio and derivative used by the sampler are selected at compile
+    time, see sampler.h.
 
     Parameters
     ----------
     interaction : boolean
         Toggle interaction between particles on / off.
     */
+    this->interaction = interaction;
 
-    if ((n_dims == 1) and !(interaction))
-    {
-        wave_function_ptr = &wave_function_1d_no_interaction_with_loop;
-        wave_function_diff_wrt_alpha_ptr = &wave_function_1d_diff_wrt_alpha;
-    }
-    else if ((n_dims == 2) and !(interaction))
-    {
-        wave_function_ptr = &wave_function_2d_no_interaction_with_loop;
-        wave_function_diff_wrt_alpha_ptr = &wave_function_2d_diff_wrt_alpha;
-    }
-    else if ((n_dims == 3) and !(interaction))
-    {
-        wave_function_ptr = &wave_function_3d_no_interaction_with_loop;
-        wave_function_diff_wrt_alpha_ptr = &wave_function_3d_diff_wrt_alpha;
+    for (Walker &walker : walkers)
+    {   // The distance cache is only in use with interaction.
+        walker.distances = interaction ? DistanceCache(n_particles, n_dims) : DistanceCache();
+        walker.distances.compute(walker.pos_current);
     }
-    else if ((n_dims == 1) and (interaction))
+
+    if ((n_dims == 1) and (interaction))
     {
         not_implemented_error("wave function", interaction);
     }
@@ -199,13 +759,53 @@ void VMC::set_wave_function(bool interaction)
     {
         not_implemented_error("wave function", interaction);
     }
-    else if ((n_dims == 3) and (interaction))
+
+    call_set_wave_function = true;
+}
+
+double VMC::local_energy_total(
+    const arma::Mat<double> &pos,
+    const DistanceCache &distances,
+    const double alpha,
+    const double beta
+)
+{   /*
+    Total local energy of all particles. Uses the whole-configuration
+    expression if one is set, else the per-particle local energy summed
+    over all particles.
+
+    Parameters
+    ----------
+    pos : arma::Mat<double> reference
+        Positions of all particles.
+
+    distances : DistanceCache reference
+        Pairwise distances of all particles in 'pos'.
+
+    alpha : constant double
+        Current variational parameter.
+
+    beta : constant double
+        Current variational parameter in the z direction.
+    */
+    if (local_energy_total_ptr != nullptr)
     {
-        wave_function_ptr = &wave_function_3d_interaction_with_loop;
-        wave_function_diff_wrt_alpha_ptr = &wave_function_3d_diff_wrt_alpha;
+        return local_energy_total_ptr(pos, distances, alpha, beta, n_particles);
     }
 
-    call_set_wave_function = true;
+    double res = 0;
+    for (int particle_inner = 0; particle_inner < n_particles; particle_inner++)
+    {
+        res += local_energy_ptr(
+            pos,
+            distances,
+            alpha,
+            beta,
+            particle_inner,
+            n_particles
+        );
+    }
+    return res;
 }
 
 void VMC::not_implemented_error(std::string name, bool interaction)
@@ -216,11 +816,291 @@ void VMC::not_implemented_error(std::string name, bool interaction)
     exit(0);
 }
 
-void VMC::one_variation(int variation)
+bool VMC::overlaps(const arma::Mat<double> &pos, const int particle)
+{   /*
+    Check whether 'particle' is closer than 'a' to any of the particles
+    with a lower index.
+
+    Parameters
+    ----------
+    pos : arma::Mat<double> reference
+        Positions of all particles.
+
+    particle : constant integer
+        Index of the particle to check.
+    */
+    double particle_distance;
+    double diff;
+
+    for (int particle_inner = 0; particle_inner < particle; particle_inner++)
+    {
+        particle_distance = 0;
+        for (int dim = 0; dim < n_dims; dim++)
+        {
+            diff = pos(dim, particle) - pos(dim, particle_inner);
+            particle_distance += diff*diff;
+        }
+        if (std::sqrt(particle_distance) <= a) return true;
+    }
+    return false;
+}
+
+void VMC::draw_initial_positions(Walker &walker)
 {
     std::cout << "NotImplementedError" << std::endl;
 }
 
+void VMC::sample_walker(
+    Walker &walker,
+    const double alpha,
+    const int n_cycles,
+    const bool resume
+)
+{   /*
+    Run a single walker for one variation. Implemented by the sampling
+    methods, which pass themselves to VMC::dispatch_walker.
+    */
+    std::cout << "NotImplementedError" << std::endl;
+}
+
+
+void VMC::one_variation(int variation)
+{   /*
+    Perform calculations for a single variational parameter. The
+    chunk_cycles cycles are divided between n_walkers independent
+    walkers, and the walkers are divided between the threads.  Each
+    walker draws its own initial positions and runs its burn-in before
+    it starts sampling, see VMC::burn_in.  The walker results are summed in walker
+    order after the parallel region, so the result does not depend on
+    which thread ran which walker.  In a distributed run, every rank
+    runs its own block of the walkers and the walker results of all
+    ranks are gathered before they are summed, see distributed.h.
+
+    With a target error set by set_target_error, the walkers continue
+    their chains in chunks of chunk_cycles cycles until the blocking
+    error of the energy is below the target, or the cycle cap is hit.
+    The energy of every sampled cycle is passed to the energy sink, if
+    one is set.
+
+    Parameters
+    ----------
+    variation : int
+        Which iteration of variational parameter alpha.
+    */
+    const double alpha = alphas(variation);
+    beta = betas(variation);
+    const int cycles_per_walker = chunk_cycles/n_walkers;
+    const int cycles_remainder = chunk_cycles%n_walkers;
+    long n_cycles_total = 0;    // Sampled cycles of all walkers.
+    int first_chunk = 0;
+
+    if (restarting)
+    {   /*
+        Continue from the chunk of the checkpoint. The walkers have
+        been loaded by restart.
+        */
+        first_chunk = restart_chunk;
+        n_cycles_total = restart_cycles;
+        restarting = false;
+    }
+
+    if (energy_sink != nullptr)
+    {
+        energy_sink->begin_variation(variation, alpha, n_walkers, run_metadata());
+    }
+
+    for (int chunk = first_chunk; ; chunk++)
+    {
+        const int n_local_walkers = walkers.size();
+        #pragma omp parallel for schedule(static)
+        for (int walker_index = 0; walker_index < n_local_walkers; walker_index++)
+        {
+            Walker &walker = walkers[walker_index];
+            const int n_cycles = cycles_per_walker + (walker.id < cycles_remainder);
+
+            // Stream 'walker.id', with a separate range of blocks for
+            // every variation.
+            if (chunk == 0)
+            {
+                walker.random.seed(seed, walker.id);
+                walker.random.skip(static_cast<std::uint64_t>(variation) << 40);
+            }
+            sample_walker(walker, alpha, n_cycles, chunk > 0);
+        }   // Parallel end.
+        n_cycles_total += chunk_cycles;
+
+        // Blocking analysis of the chains so far. The walker chains are
+        // ended on copies, so that they can be continued.
+        std::vector<BlockingAccumulator> chains;
+        for (const Walker &walker : walkers)
+        {
+            chains.push_back(walker.energy_blocking);
+            chains.back().end_chain();
+        }
+        if (distributed) chains = distributed_all_gather(chains, n_walkers);
+
+        energy_blocking.reset();
+        for (const BlockingAccumulator &chain : chains) energy_blocking.merge(chain);
+        energy_blocking.analyze();
+
+        if (target_error <= 0) break;
+        if (energy_blocking.get_error() < target_error) break;
+        if (n_cycles_total + chunk_cycles > max_cycles)
+        {
+            if (debug)
+            {
+                std::cout << "Target error not reached for variation " << variation;
+                std::cout << " after " << n_cycles_total << " cycles." << std::endl;
+            }
+            break;
+        }
+        checkpoint(variation, chunk + 1, n_cycles_total);
+    }
+    cycles(variation) = n_cycles_total;
+    if (energy_sink != nullptr) energy_sink->end_variation();
+
+    // Walker accumulators of all ranks, one row per walker.
+    const int K = n_wave_parameters;
+    const int derivative_row = 4;
+    const int times_energy_row = derivative_row + K;
+    const int products_row = times_energy_row + K;
+    const int bins_row = products_row + K*K;
+    const int variance_row = bins_row + n_bins;
+    const int n_rows = variance_row + walkers[0].variance_sums.n_elem;
+    arma::Mat<double> walker_sums(n_rows, walkers.size());
+    for (std::size_t walker_index = 0; walker_index < walkers.size(); walker_index++)
+    {
+        const Walker &walker = walkers[walker_index];
+        walker_sums(0, walker_index) = walker.acceptance;
+        walker_sums(1, walker_index) = walker.energy_expectation;
+        walker_sums(2, walker_index) = walker.energy_expectation_squared;
+        walker_sums(3, walker_index) = walker.burn_in_cycles;
+        for (int k = 0; k < K; k++)
+        {
+            walker_sums(derivative_row + k, walker_index) = walker.wave_derivative_expectation[k];
+            walker_sums(times_energy_row + k, walker_index) = walker.wave_times_energy_expectation[k];
+        }
+        for (int kl = 0; kl < K*K; kl++)
+        {
+            walker_sums(products_row + kl, walker_index) = walker.wave_derivative_products_expectation[kl];
+        }
+        for (int bin = 0; bin < n_bins; bin++)
+        {
+            walker_sums(bins_row + bin, walker_index) = walker.particle_per_bin_count(bin);
+        }
+        for (arma::uword sum = 0; sum < walker.variance_sums.n_elem; sum++)
+        {
+            walker_sums(variance_row + sum, walker_index) = walker.variance_sums(sum);
+        }
+    }
+    arma::Mat<double> all_walker_sums = walker_sums;
+    if (distributed)
+    {
+        all_walker_sums = arma::Mat<double>(n_rows, n_walkers);
+        distributed_all_gather(
+            walker_sums.memptr(),
+            all_walker_sums.memptr(),
+            n_rows*sizeof(double),
+            n_walkers
+        );
+    }
+
+    // Reset values for each variation.
+    long acceptance = 0;
+    long burn_in = 0;
+    energy_expectation = 0;
+    energy_expectation_squared = 0;
+    wave_derivative_expectation.zeros();
+    wave_times_energy_expectation.zeros();
+    wave_derivative_products_expectation.zeros();
+    particle_per_bin_count.col(variation).zeros();
+
+    for (int walker_index = 0; walker_index < n_walkers; walker_index++)
+    {   /*
+        Sum the walker accumulators in a fixed order.
+        */
+        acceptance += static_cast<long>(all_walker_sums(0, walker_index));
+        energy_expectation += all_walker_sums(1, walker_index);
+        energy_expectation_squared += all_walker_sums(2, walker_index);
+        burn_in += static_cast<long>(all_walker_sums(3, walker_index));
+        for (int k = 0; k < K; k++)
+        {
+            wave_derivative_expectation(k) += all_walker_sums(derivative_row + k, walker_index);
+            wave_times_energy_expectation(k) += all_walker_sums(times_energy_row + k, walker_index);
+            for (int l = 0; l < K; l++)
+            {
+                wave_derivative_products_expectation(k, l) +=
+                    all_walker_sums(products_row + k*K + l, walker_index);
+            }
+        }
+        for (int bin = 0; bin < n_bins; bin++)
+        {
+            particle_per_bin_count(bin, variation) += all_walker_sums(bins_row + bin, walker_index);
+        }
+    }
+
+    acceptances(variation) = acceptance;    // Debug.
+    burn_in_cycles(variation) = burn_in;
+    energy_expectation /= n_cycles_total;
+    energy_expectation /= n_particles;
+    energy_expectation_squared /= n_cycles_total;
+    energy_expectation_squared /= n_particles;
+    energy_variance = energy_expectation_squared
+        - energy_expectation*energy_expectation;
+
+    // Standard error of the energy by automatic blocking of the local
+    // energy after each cycle.
+    energy_error = energy_blocking.get_error();
+    if (debug and !energy_blocking.get_converged())
+    {
+        std::cout << "Blocking: Use more data for variation " << variation << "." << std::endl;
+    }
+
+    // GD specifics.
+    wave_times_energy_expectation /= n_cycles_total;
+    wave_derivative_expectation /= n_cycles_total;
+    wave_derivative_products_expectation /= n_cycles_total;
+    // GD specifics end.
+
+    // Variance objective specifics.
+    variance_gradient.zeros();
+    if (n_variance_parameters > 0)
+    {   /*
+        d var(E)/dk = 2 (<E dE/dk> - <E><dE/dk>) + 2 (<O_k E^2> -
+        <O_k><E^2>) - 4 <E> (<O_k E> - <O_k><E>), from the sums of
+        every sampled cycle, see variance_cycle.  Scaled by n_particles
+        like the energy gradient of GradientDescent::solve.
+        */
+        arma::Col<double> means(n_rows - variance_row);
+        means.zeros();
+        for (int walker_index = 0; walker_index < n_walkers; walker_index++)
+        {
+            for (int sum = 0; sum < n_rows - variance_row; sum++)
+            {
+                means(sum) += all_walker_sums(variance_row + sum, walker_index);
+            }
+        }
+        means /= n_cycles_total;
+
+        const double energy = means(0);
+        const double energy_squared = means(1);
+        for (int k = 0; k < n_variance_parameters; k++)
+        {
+            const double wave = means(2 + k);
+            const double wave_energy = means(2 + K + k);
+            const double wave_energy_squared = means(2 + 2*K + k);
+            const double energy_derivative = means(2 + 3*K + k);
+            const double energy_energy_derivative = means(2 + 4*K + k);
+            variance_gradient(k) = n_particles*(
+                2*(energy_energy_derivative - energy*energy_derivative)
+                + 2*(wave_energy_squared - wave*energy_squared)
+                - 4*energy*(wave_energy - wave*energy)
+            );
+        }
+    }
+    // Variance objective specifics end.
+}
+
 void VMC::solve()
 {   /*
     Iterate over variational parameters. Extract energy variances and
@@ -255,7 +1135,7 @@ void VMC::solve()
         std::chrono::duration<double> comp_time;
     #endif
 
-    for (int variation = 0; variation < n_variations; variation++)
+    for (int variation = first_variation(); variation < n_variations; )
     {
         #ifdef _OPENMP
             t1 = omp_get_wtime();
@@ -263,35 +1143,51 @@ void VMC::solve()
             t1 = std::chrono::steady_clock::now();
         #endif
 
+        if (!restarting or (restart_chunk == 0)) set_reweight_alphas(variation);
         one_variation(variation);
         e_expectations(variation) = energy_expectation;
         e_variances(variation) = energy_variance;
-
-        std::cout << "variation : " << std::setw(3) <<  variation;
-        std::cout << ", alpha: " << std::setw(10) << alphas(variation);
-        std::cout << ", energy: " << std::setw(10) << energy_expectation;
-        std::cout << ", variance: " << std::setw(10) << energy_variance;
-        std::cout << ", acceptance: " << std::setw(10) << acceptances(variation)/(n_mc_cycles*n_particles);
+        e_errors(variation) = energy_error;
 
         #ifdef _OPENMP
             t2 = omp_get_wtime();
             comp_time = t2 - t1;
-            std::cout << ",  time : " << comp_time << "s" << std::endl;
             timing(variation) = comp_time;
         #else
             t2 = std::chrono::steady_clock::now();
             comp_time = std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1);
-            std::cout << ",  time : " << comp_time.count() << "s" << std::endl;
             timing(variation) = comp_time.count();
         #endif
 
+        if (verbose)
+        {
+            std::cout << "variation : " << std::setw(3) <<  variation;
+            std::cout << ", alpha: " << std::setw(10) << alphas(variation);
+            std::cout << ", energy: " << std::setw(10) << energy_expectation;
+            std::cout << ", error: " << std::setw(10) << energy_error;
+            std::cout << ", variance: " << std::setw(10) << energy_variance;
+            std::cout << ", acceptance: " << std::setw(10) << acceptances(variation)/(cycles(variation)*n_particles);
+            std::cout << ", burn-in: " << std::setw(8) << burn_in_cycles(variation);
+            std::cout << ",  time : " << timing(variation) << "s" << std::endl;
+        }
+
+        // With correlated sampling, the chain may also have given the
+        // energies of the following variations.
+        const int next_variation = (reweight_alphas.n_elem > 0) ? reweight(variation) : variation + 1;
+        checkpoint(next_variation, 0, 0);
+        variation = next_variation;
     }
 }
 
 void VMC::write_to_file(std::string fpath)
 {   /*
     Write data to file. Columns 1, 2, 3 are: alpha, energy variance,
-    energy expectation value.
+    energy expectation value.  Column 6 is the blocking estimate of the
+    standard error of the energy, column 7 the number of sampled MC
+    cycles and column 8 the number of burn-in cycles, both summed over
+    all walkers.  Column 9 is beta.  Column 10 is the variation whose
+    chain gave the result, which differs from the row with correlated
+    sampling, see set_reweighting.
 
     Parameters
     ----------
@@ -303,7 +1199,12 @@ void VMC::write_to_file(std::string fpath)
     outfile << std::setw(20) << "variance_energy";
     outfile << std::setw(21) << "expected_energy";
     outfile << std::setw(21) << "time";
-    outfile << std::setw(21) << "acceptance_rate\n";
+    outfile << std::setw(21) << "acceptance_rate";
+    outfile << std::setw(21) << "blocking_error";
+    outfile << std::setw(21) << "mc_cycles";
+    outfile << std::setw(21) << "burn_in_cycles";
+    outfile << std::setw(21) << "beta";
+    outfile << std::setw(21) << "reference_variation\n";
 
     for (int i = 0; i < n_variations_final; i++)
     {   /*
@@ -318,33 +1219,58 @@ void VMC::write_to_file(std::string fpath)
         outfile << std::setw(20) << std::setprecision(10);
         outfile << timing(i);
         outfile << std::setw(20) << std::setprecision(10);
-        outfile << acceptances(i)/(n_particles*n_mc_cycles) << "\n";
+        outfile << acceptances(i)/(n_particles*cycles(i));
+        outfile << std::setw(20) << std::setprecision(10);
+        outfile << e_errors(i);
+        outfile << std::setw(20);
+        outfile << static_cast<long>(cycles(i));
+        outfile << std::setw(20);
+        outfile << static_cast<long>(burn_in_cycles(i));
+        outfile << std::setw(20) << std::setprecision(10);
+        outfile << betas(i);
+        outfile << std::setw(20);
+        outfile << static_cast<int>(reference_variations(i)) << "\n";
     }
     outfile.close();
     std::cout << fpath << " written to file." << std::endl;
 }
 
-void VMC::write_energies_to_file(std::string fpath)
+void VMC::set_energy_sink(EnergySink *energy_sink_input)
 {   /*
-    Write energy data to file.
+    Pass the local energy of every sampled cycle to 'energy_sink_input',
+    e.g. a MemorySink, FileSink or DecimatedSink.  The sink is not owned
+    and must outlive solve.  nullptr, the default, keeps only the
+    blocking analysis, so that memory use does not grow with the number
+    of cycles.
 
     Parameters
     ----------
-    fpath : std::string
-        Relative file path and name.
+    energy_sink_input : EnergySink pointer
+        The sink, or nullptr.
     */
-    outfile.open(fpath, std::ios::out);
+    energy_sink = energy_sink_input;
+}
 
-    outfile << "alphas" << "\n";
-    for (int i = 0; i < n_variations_final; i++){
-      outfile << std::setw(20) << std::setprecision(10);
-      outfile << alphas(i);
-    }
-    outfile << "\n";
-    arma::Mat<double> energies_subview = energies.cols(0, n_variations_final - 1); 
-    energies_subview.save(outfile, arma::raw_ascii);
-    outfile.close();
-    std::cout << fpath << " written to file." << std::endl;
+std::string VMC::run_metadata()
+{   /*
+    Run metadata as "key=value" lines, e.g. for the header of the
+    binary energy file.
+    */
+    std::ostringstream header;
+    header << std::setprecision(17);
+    header << "n_particles=" << n_particles << "\n";
+    header << "n_dims=" << n_dims << "\n";
+    header << "n_mc_cycles=" << n_mc_cycles << "\n";
+    header << "n_variations=" << n_variations << "\n";
+    header << "n_walkers=" << n_walkers << "\n";
+    header << "n_burn_in_cycles=" << n_burn_in_cycles << "\n";
+    header << "burn_in_window=" << burn_in_window << "\n";
+    header << "beta=" << beta << "\n";
+    header << "a=" << a << "\n";
+    header << "interaction=" << interaction << "\n";
+    header << "numerical_differentiation=" << numerical_differentiation << "\n";
+    header << "seed=" << seed << "\n";
+    return header.str();
 }
 
 void VMC::write_to_file_onebody_density(std::string fpath)
@@ -10,8 +10,17 @@
 #include <armadillo>        // Linear algebra.
 #include <sstream>
 #include <string>           // String type, string maipulation.
+#include <vector>           // Walkers.
+#include <algorithm>        // std::min.
+#include <limits>           // Infinity.
 #include "omp.h"            // Parallelization.
+#include <cstdio>           // std::rename.
 #include "forward.hpp"      // Numerical differentiation.
+#include "distance_cache.h"
+#include "incremental_local_energy.h"
+#include "walker.h"
+#include "blocking.h"
+#include "energy_sink.h"
 #include "wave_function.h"
 #include "local_energy.h"
 #include "quantum_force.h"
@@ -25,85 +34,186 @@ class VMC
         std::ofstream outfile;          // Output file.
         const int n_variations;         // Number of variations.
         const int n_mc_cycles;          // Number of MC cycles.
-        double seed = 1337;             // Default RNG seed.
+        int chunk_cycles;               // MC cycles of the next variation, or of each chunk. Usually n_mc_cycles.
+        std::uint64_t seed = 1337;      // Default RNG seed.
         const int n_particles;          // Number of particles.
         const int n_dims;               // Number of spatial dimensions.
 
-        const double beta;
+        double beta;                    // Beta of the current variation.
         const double diffusion_coeff = 0.5;
 
         double energy_expectation_squared;  // Square of the energy expectation value.
-        double local_energy;                // Local energy.
-        double exponential_diff;            // Difference of the exponentials, for Metropolis.
-        double wave_current;                // Current wave function.
-        double wave_new;                    // Proposed new wave function.
         double energy_expectation = 0;
         double energy_variance = 0;
-
-        int particle;       // Index for particle loop.
-        int particle_inner; // Index for inner particle loops.
-        int mc;             // Index for MC loop.
-        int dim;            // Index for dimension loops.
-        int bin;            // Index for bin loop.
+        // Log derivatives O_k of the wave function with respect to
+        // alpha and beta, for gradient descent.
+        arma::Col<double> wave_derivative_expectation;          // <O_k>
+        arma::Col<double> wave_times_energy_expectation;        // <O_k E>
+        arma::Mat<double> wave_derivative_products_expectation; // <O_k O_l>
+        double energy_error = 0;                    // Blocking estimate of the standard error.
+        BlockingAccumulator energy_blocking;        // Blocking sums of all walkers in the current variation.
 
         int n_variations_final; // If calculation is stopped before n_variations is reached.
         bool call_set_quantum_force = false;
         bool call_set_wave_function = false;
         bool call_set_local_energy = false;
         bool numerical_differentiation = false;
+        bool interaction = false;               // Set by set_wave_function.
+        bool incremental_local_energy = false;  // Update the local energy with Walker::local_energy_engine.
+        const int local_energy_refresh_interval = 1000; // MC cycles between full recalculations.
         bool debug = false;     // Toggle debug print on / off.
+        bool verbose = true;    // Toggle the print of every variation on / off.
+        bool distributed = true;    // Divide the walkers between the ranks, see distributed.h.
+
+        // Walker parameters.
+        int n_threads;                  // Number of OpenMP threads.
+        int n_walkers;                  // Total number of walkers of all ranks. 'walkers' holds those of this rank.
+        int n_burn_in_cycles = 1000;    // Discarded MC cycles at the start of every walker.
+        int burn_in_window = 0;         // Cycles per window of the automatic burn-in. 0 for off.
+        int max_burn_in_cycles = 0;     // Cap on the burn-in cycles per walker with automatic burn-in.
+        double target_error = 0;        // Run chunks until the energy error is below this. 0 for off.
+        long max_cycles = 0;            // Cap on the sampled MC cycles with a target error.
+        // Walker parameters end.
+
+        // Checkpoint parameters.
+        std::string checkpoint_fpath;       // Empty for no checkpoints.
+        double checkpoint_interval = 0;     // Minimum wall time in seconds between checkpoints.
+        double checkpoint_time;             // Wall time of the last checkpoint.
+        bool restarting = false;            // Resume from the loaded checkpoint.
+        int restart_variation = 0;          // Variation to resume.
+        int restart_chunk = 0;              // Chunk to resume. 0 starts the variation from scratch.
+        long restart_cycles = 0;            // Cycles sampled in the chunks before 'restart_chunk'.
+        // Checkpoint parameters end.
+
+        // Correlated sampling parameters.
+        double min_ess_fraction = 0;            // Minimum effective sample size fraction. 0 for off.
+        const double reweight_step = 0.01;      // Alpha step for the local energy polynomial.
+        arma::Col<double> reweight_alphas;      // Target alphas of the current reference chain.
+        arma::Col<double> reference_variations; // Variation whose chain gave each result.
+        // Correlated sampling parameters end.
+
+        // Variance objective parameters.
+        int n_variance_parameters = 0;          // Parameters of the variance gradient. 0 for off.
+        const double derivative_step = 0.01;    // Parameter step for the local energy derivatives.
+        arma::Col<double> variance_gradient;    // Gradient of the energy variance, see one_variation.
+        // Variance objective parameters end.
+
+        std::vector<Walker> walkers;    // Independent Markov chains.
 
         // One-body density parameters.
         int n_bins;                             // Number of bins.
         double r_bins_end;                      // End of final bin. Radial distance.
         arma::Col<double> bin_locations;        // Radial location of the start of each bin.
         arma::Mat<double> particle_per_bin_count;  // Count the number of particles per bin.
-        arma::Col<double> particle_per_bin_count_thread;
         // One-body density parameters end.
 
         // Moved initialization to class constructor.
-        arma::Mat<double> pos_new;       // Proposed new position.
-        arma::Mat<double> pos_current;   // Current position.
         arma::Col<double> e_variances;   // Energy variances.
         arma::Col<double> e_expectations;// Energy expectation values.
+        arma::Col<double> e_errors;      // Blocking estimate of the standard error of the energy.
+        arma::Col<double> cycles;        // Number of sampled MC cycles.
+        arma::Col<double> burn_in_cycles;// Number of discarded MC cycles of all walkers.
         arma::Col<double> alphas;        // Variational parameter.
-        arma::Mat<double> qforce_current;// Current quantum force.
-        arma::Mat<double> qforce_new;    // New quantum force.
+        arma::Col<double> betas;         // Variational parameter in the z direction.
 
-        arma::Row<double> test_local;    // Temporary. TODO: Remove?
-        arma::Mat<double> energies;
-
-        std::mt19937 engine;      // Mersenne Twister RNG.
-        std::uniform_real_distribution<double> uniform;  // Continuous uniform distribution.
-        std::normal_distribution<double> normal;         // Gaussian distribution
+        EnergySink *energy_sink = nullptr;      // Receives the energy of every cycle. Not owned.
 
         arma::Col<double> timing;
 
         double (*local_energy_ptr)(
             const arma::Mat<double> &pos,
+            const DistanceCache &distances,
             const double alpha,
             const double beta,
             const int current_particle,
             const int n_particles
         );
-        double (*wave_function_ptr)(
+        double (*local_energy_total_ptr)(
             const arma::Mat<double> &pos,
-            double alpha,
-            double beta,
+            const DistanceCache &distances,
+            const double alpha,
+            const double beta,
             const int n_particles
         );
-        arma::Mat<double> (*quantum_force_ptr)(
+
+        double local_energy_total(
             const arma::Mat<double> &pos,
+            const DistanceCache &distances,
             const double alpha,
-            const double beta,
-            const int current_particle, 
-            const int n_particles
+            const double beta
+        );
+        void check_n_walkers(const int n_walkers_input);
+        void allocate_walkers(const int n_walkers_input);
+        virtual void save_state(std::ostream &outfile) const;
+        virtual void load_state(std::istream &infile);
+        void set_reweight_alphas(const int variation);
+        int reweight(const int reference);
+        void set_variance_gradient(const int n_parameters);
+        bool overlaps(const arma::Mat<double> &pos, const int particle);
+        template <bool interaction_t>
+        void reject_move(Walker &walker, const int particle);
+        virtual void draw_initial_positions(Walker &walker);
+        virtual void sample_walker(
+            Walker &walker,
+            const double alpha,
+            const int n_cycles,
+            const bool resume
+        );
+
+        // Sampler, templated on the number of dimensions and on
+        // interaction. Defined in sampler.h.
+        template <int dims, bool interaction_t>
+        double wave_function_log_ratio(Walker &walker, const int particle, const double alpha);
+        template <int dims, bool interaction_t>
+        void quantum_force(
+            arma::Mat<double> &force,
+            const arma::Mat<double> &pos,
+            const DistanceCache &distances,
+            const int particle,
+            const double alpha
         );
-        double (*wave_function_diff_wrt_alpha_ptr)(
+        template <int dims, bool interaction_t>
+        double local_energy_total(
             const arma::Mat<double> &pos,
+            const DistanceCache &distances,
             const double alpha,
             const double beta
         );
+        template <int dims, bool interaction_t>
+        void initialize_walker(Walker &walker, const double alpha);
+        template <int dims, bool interaction_t>
+        void accept_move(Walker &walker, const int particle, const double alpha);
+        template <class Method, int dims, bool interaction_t>
+        void mc_cycle(
+            Method &method,
+            Walker &walker,
+            const double alpha,
+            const int cycle,
+            const bool sample
+        );
+        template <int dims, bool interaction_t>
+        void reweight_cycle(Walker &walker, const double alpha);
+        template <int dims, bool interaction_t>
+        void variance_cycle(Walker &walker, const double alpha);
+        template <class Method, int dims, bool interaction_t>
+        long burn_in(Method &method, Walker &walker, const double alpha);
+        template <class Method, int dims, bool interaction_t>
+        void run_walker(
+            Method &method,
+            Walker &walker,
+            const double alpha,
+            const int n_cycles,
+            const bool resume
+        );
+        template <class Method>
+        void dispatch_walker(
+            Method &method,
+            Walker &walker,
+            const double alpha,
+            const int n_cycles,
+            const bool resume
+        );
+        // Sampler end.
 
     public:
         arma::Col<double> acceptances;   // Debug.
@@ -118,15 +228,35 @@ class VMC
             bool debug_input
         );
         void set_seed(double seed_input);
+        void set_walkers_per_thread(const int walkers_per_thread_input);
+        void set_n_walkers(const int n_walkers_input);
+        void set_burn_in(const int n_burn_in_cycles_input);
+        void set_auto_burn_in(const int burn_in_window_input, const int max_burn_in_cycles_input);
+        void set_target_error(const double target_error_input, const long max_cycles_input);
+        void set_reweighting(const double min_ess_fraction_input);
         void set_quantum_force(bool interaction);
         void set_local_energy(bool interaction);
         void set_wave_function(bool interaction);
         void write_to_file(std::string fname);
-        void write_energies_to_file(std::string fpath);
+        void set_energy_sink(EnergySink *energy_sink_input);
+        void set_checkpoint(std::string fpath, const double interval);
+        void set_distributed(const bool distributed_input);
+        void set_verbose(const bool verbose_input);
+        double get_energy(const int variation) const;
+        double get_energy_variance(const int variation) const;
+        double get_energy_error(const int variation) const;
+        double get_acceptance_rate(const int variation) const;
+        double get_time(const int variation) const;
+        double get_burn_in_cycles(const int variation) const;
+        void restart(std::string fpath);
         void write_to_file_onebody_density(std::string fpath);
         void solve();
         virtual void one_variation(int variation);
         void not_implemented_error(std::string name, bool interaction);
+        void checkpoint(const int variation, const int chunk, const long n_cycles_total);
+        int first_variation();
+        std::string checkpoint_rank_fpath(const std::string fpath);
+        std::string run_metadata();
         ~VMC();
 };
 
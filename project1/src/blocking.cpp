@@ -0,0 +1,209 @@
+#include "blocking.h"
+
+// Chi-squared quantiles for alpha = 0.05, as in scripts/blocking.py.
+static const double chi_squared_quantiles[] = {
+    3.841, 5.991, 7.815, 9.488, 11.070, 12.592, 14.067, 15.507,
+    16.919, 18.307, 19.675, 21.026, 22.362, 23.685, 24.996, 26.296,
+    27.587, 28.869, 30.144, 31.410, 32.671, 33.924, 35.172, 36.415,
+    37.652, 38.885, 40.113, 41.337, 42.557, 43.773, 44.985, 46.194,
+    47.400, 48.602, 49.802, 50.998, 52.192, 53.384, 54.572, 55.758,
+    56.942, 58.124, 59.304, 60.481, 61.656, 62.830, 64.001, 65.171,
+    66.339, 67.505, 68.669, 69.832, 70.993, 72.153, 73.311, 74.468,
+    75.624, 76.778, 77.931, 79.082, 80.232, 81.381, 82.529, 83.675
+};
+
+BlockingAccumulator::BlockingAccumulator()
+{   /*
+    Class constructor.
+    */
+    reset();
+}
+
+void BlockingAccumulator::reset()
+{   /*
+    Remove all data. Called at the start of every variation.
+    */
+    for (int k = 0; k < max_levels; k++)
+    {
+        count[k] = 0;
+        sum[k] = 0;
+        sum_squared[k] = 0;
+        sum_lag_product[k] = 0;
+        sum_ends[k] = 0;
+        n_chains[k] = 0;
+
+        chain_count[k] = 0;
+        last[k] = 0;
+        pending[k] = 0;
+        has_pending[k] = false;
+    }
+    mean = 0;
+    error = 0;
+    naive_error = 0;
+    level = 0;
+    converged = false;
+}
+
+void BlockingAccumulator::add(const double value)
+{   /*
+    Append a value to the current chain.
+
+    Parameters
+    ----------
+    value : constant double
+        The next value of the time series.
+    */
+    add_to_level(0, value);
+}
+
+void BlockingAccumulator::add_to_level(int level_index, double value)
+{   /*
+    Append a value to blocking level 'level_index' of the current chain
+    and carry the pair means up through the levels.
+    */
+    while (level_index < max_levels)
+    {
+        if (chain_count[level_index] == 0)
+        {
+            sum_ends[level_index] += value;     // First value of the chain.
+            n_chains[level_index] += 1;
+        }
+        else
+        {
+            sum_lag_product[level_index] += last[level_index]*value;
+        }
+        last[level_index] = value;
+        chain_count[level_index]++;
+        count[level_index] += 1;
+        sum[level_index] += value;
+        sum_squared[level_index] += value*value;
+
+        if (!has_pending[level_index])
+        {
+            pending[level_index] = value;
+            has_pending[level_index] = true;
+            return;
+        }
+        has_pending[level_index] = false;
+        value = 0.5*(pending[level_index] + value);
+        level_index++;
+    }
+}
+
+void BlockingAccumulator::end_chain()
+{   /*
+    End the current chain. Values added afterwards start a new,
+    independent chain.
+    */
+    for (int k = 0; k < max_levels; k++)
+    {
+        if (chain_count[k] > 0) sum_ends[k] += last[k];     // Last value of the chain.
+        chain_count[k] = 0;
+        has_pending[k] = false;
+    }
+}
+
+void BlockingAccumulator::merge(const BlockingAccumulator &other)
+{   /*
+    Add the chains of 'other' to this accumulator. 'other' must have
+    ended its chain.
+
+    Parameters
+    ----------
+    other : BlockingAccumulator reference
+        Accumulator of an independent walker.
+    */
+    for (int k = 0; k < max_levels; k++)
+    {
+        count[k] += other.count[k];
+        sum[k] += other.sum[k];
+        sum_squared[k] += other.sum_squared[k];
+        sum_lag_product[k] += other.sum_lag_product[k];
+        sum_ends[k] += other.sum_ends[k];
+        n_chains[k] += other.n_chains[k];
+    }
+}
+
+void BlockingAccumulator::analyze()
+{   /*
+    Find the blocking level where the blocked values are uncorrelated
+    and estimate the standard error of the mean from it.  With
+    gamma_k the lag-one autocovariance and s_k the variance of the
+    values at level k, which holds n_k values, the test statistic
+
+        M_k = sum_{j >= k} n_j (gamma_j/s_j)^2
+
+    is compared to the chi-squared quantiles.  The error is
+    sqrt(s_k/n_k) at the first level where M_k is below the quantile.
+    Only levels with at least one neighbouring pair are used.  All
+    chains must have ended.
+    */
+    mean = 0;
+    error = 0;
+    naive_error = 0;
+    level = 0;
+    converged = false;
+    if (count[0] < 2) return;
+
+    mean = sum[0]/count[0];
+
+    int n_levels = 0;
+    while ((n_levels < max_levels) and (count[n_levels] - n_chains[n_levels] >= 1))
+    {
+        n_levels++;
+    }
+
+    if (n_levels == 0)
+    {   /*
+        Every chain holds a single value, so there are no neighbouring
+        pairs to test.  Fall back to the naive error.
+        */
+        const double variance_naive = std::fmax(sum_squared[0]/count[0] - mean*mean, 0);
+        naive_error = std::sqrt(variance_naive/count[0]);
+        error = naive_error;
+        return;
+    }
+
+    double variance[max_levels];
+    double test_terms[max_levels];
+    for (int k = 0; k < n_levels; k++)
+    {   /*
+        gamma_k = 1/n_k sum_i (x_i - mean)(x_{i+1} - mean), expanded in
+        the running sums.  The first values of the chains are missing
+        from the x_{i+1}, and the last values from the x_i.
+        */
+        const double n_pairs = count[k] - n_chains[k];
+        const double gamma = (
+            sum_lag_product[k]
+            - mean*(2*sum[k] - sum_ends[k])
+            + n_pairs*mean*mean
+        )/count[k];
+        const double level_mean = sum[k]/count[k];
+        variance[k] = std::fmax(sum_squared[k]/count[k] - level_mean*level_mean, 0);
+
+        if (variance[k] > 0) test_terms[k] = count[k]*(gamma/variance[k])*(gamma/variance[k]);
+        else test_terms[k] = 0;     // Constant series, e.g. the exact wave function.
+    }
+
+    naive_error = std::sqrt(variance[0]/count[0]);
+
+    double test_statistic = 0;
+    double test_statistics[max_levels];
+    for (int k = n_levels - 1; k >= 0; k--)
+    {
+        test_statistic += test_terms[k];
+        test_statistics[k] = test_statistic;
+    }
+
+    level = n_levels - 1;
+    for (int k = 0; k < n_levels; k++)
+    {
+        if (test_statistics[k] < chi_squared_quantiles[k])
+        {
+            level = k;
+            break;
+        }
+    }
+    converged = level < n_levels - 1;
+    error = std::sqrt(variance[level]/count[level]);
+}
@@ -0,0 +1,69 @@
+#ifndef BLOCKING
+#define BLOCKING
+
+#include <cmath>
+
+class BlockingAccumulator
+{   /*
+    Streaming version of the automatic blocking method of Jonsson (Phys.
+    Rev. E 98, 043304, 2018), see also scripts/blocking.py.  Instead of
+    storing the time series, every blocking level k keeps running sums of
+    its values, their squares and the products of neighbouring values.
+    Level k receives the mean of every pair of values at level k - 1, so
+    a series of n values needs O(log n) storage and O(1) amortized work
+    per value.
+
+    Each walker feeds its own accumulator and ends its chain with
+    end_chain.  The accumulators of independent walkers are then combined
+    with merge, which pools the sums level by level.  Pairs are never
+    formed across chains, and a value left without a partner at the end
+    of a chain is dropped from the higher levels, just as blocking.py
+    assumes a power-of-two series.  The autocovariances are taken about
+    the mean of all chains, so that a single chain of length 2^d gives
+    exactly the same error as blocking.py.
+    */
+    public:
+        static const int max_levels = 64;
+
+        BlockingAccumulator();
+        void reset();
+        void add(const double value);
+        void end_chain();
+        void merge(const BlockingAccumulator &other);
+        void analyze();
+
+        double get_mean() const {return mean;}
+        double get_error() const {return error;}                    // Blocking estimate of the standard error.
+        double get_naive_error() const {return naive_error;}        // Standard error for uncorrelated samples.
+        int get_level() const {return level;}                       // Chosen blocking level.
+        bool get_converged() const {return converged;}              // False if more data is needed.
+        long get_count() const {return static_cast<long>(count[0]);}
+
+    private:
+        // Sums over all chains, per blocking level.
+        double count[max_levels];
+        double sum[max_levels];
+        double sum_squared[max_levels];
+        double sum_lag_product[max_levels];     // Sum of x_i x_{i+1} within each chain.
+        double sum_ends[max_levels];            // Sum of the first and last value of each chain.
+        double n_chains[max_levels];
+        // Sums over all chains end.
+
+        // State of the current chain, per blocking level.
+        long chain_count[max_levels];
+        double last[max_levels];
+        double pending[max_levels];             // Waiting for a partner to form the next level.
+        bool has_pending[max_levels];
+        // State of the current chain end.
+
+        // Results of analyze.
+        double mean;
+        double error;
+        double naive_error;
+        int level;
+        bool converged;
+
+        void add_to_level(int level_index, double value);
+};
+
+#endif
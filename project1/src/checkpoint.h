@@ -0,0 +1,63 @@
+#ifndef CHECKPOINT
+#define CHECKPOINT
+
+#include <istream>
+#include <ostream>
+#include <type_traits>
+#include <armadillo>
+
+/*
+Raw binary reading and writing of checkpoint data.  Checkpoints are
+only meant to be read back by the same build on the same machine, so
+values are stored with their in-memory representation.
+*/
+
+template <class T>
+void write_raw(std::ostream &outfile, const T &value)
+{   /*
+    Write the bytes of 'value'. T must be trivially copyable, e.g. a
+    number, RandomBuffer or BlockingAccumulator.
+    */
+    static_assert(std::is_trivially_copyable<T>::value, "Checkpoint values must be trivially copyable.");
+    outfile.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <class T>
+void read_raw(std::istream &infile, T &value)
+{   /*
+    Read the bytes of 'value' written by write_raw.
+    */
+    static_assert(std::is_trivially_copyable<T>::value, "Checkpoint values must be trivially copyable.");
+    infile.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+template <class T>
+void write_matrix(std::ostream &outfile, const arma::Mat<T> &matrix)
+{   /*
+    Write the shape and elements of an Armadillo matrix or vector.
+    */
+    write_raw(outfile, static_cast<std::uint64_t>(matrix.n_rows));
+    write_raw(outfile, static_cast<std::uint64_t>(matrix.n_cols));
+    outfile.write(reinterpret_cast<const char*>(matrix.memptr()), matrix.n_elem*sizeof(T));
+}
+
+template <class T>
+void read_matrix(std::istream &infile, arma::Mat<T> &matrix)
+{   /*
+    Read a matrix or vector written by write_matrix. 'matrix' must
+    already have the stored shape, so that a checkpoint from a different
+    configuration is not silently accepted.
+    */
+    std::uint64_t n_rows;
+    std::uint64_t n_cols;
+    read_raw(infile, n_rows);
+    read_raw(infile, n_cols);
+    if ((n_rows != matrix.n_rows) or (n_cols != matrix.n_cols))
+    {
+        infile.setstate(std::ios::failbit);
+        return;
+    }
+    infile.read(reinterpret_cast<char*>(matrix.memptr()), matrix.n_elem*sizeof(T));
+}
+
+#endif
@@ -0,0 +1,243 @@
+#include "config.h"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <limits>
+
+static std::string trim(const std::string &text)
+{   /*
+    Remove leading and trailing whitespace.
+    */
+    const std::size_t start = text.find_first_not_of(" \t\r\n");
+    if (start == std::string::npos) return "";
+    const std::size_t end = text.find_last_not_of(" \t\r\n");
+    return text.substr(start, end - start + 1);
+}
+
+void Config::read_file(const std::string fpath)
+{   /*
+    Read "key = value" lines from a config file. Later lines override
+    earlier ones.
+
+    Parameters
+    ----------
+    fpath : constant std::string
+        Relative file path and name.
+    */
+    std::ifstream infile(fpath);
+    if (!infile)
+    {
+        std::cout << "Could not open config file " << fpath << "! Exiting..." << std::endl;
+        exit(0);
+    }
+
+    std::string line;
+    int line_number = 0;
+    while (std::getline(infile, line))
+    {
+        line_number++;
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+
+        const std::size_t separator = line.find('=');
+        if (separator == std::string::npos)
+        {
+            std::cout << fpath << ", line " << line_number << ": expected 'key = value'. Exiting..." << std::endl;
+            exit(0);
+        }
+        set(trim(line.substr(0, separator)), trim(line.substr(separator + 1)));
+    }
+}
+
+void Config::read_arguments(int argc, char *argv[])
+{   /*
+    Read "--key value" and "--key=value" arguments.  A key without a
+    value, like "--debug", is set to 1.  If "--config <file>" is given,
+    the file is read first, so that the other arguments override it.
+    */
+    std::vector<std::pair<std::string, std::string>> arguments;
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        std::string key = argv[arg];
+        if (key.rfind("--", 0) != 0)
+        {
+            std::cout << "Unexpected argument '" << key << "'. Use --key value. Exiting..." << std::endl;
+            exit(0);
+        }
+        key = key.substr(2);
+
+        std::string value = "1";
+        const std::size_t separator = key.find('=');
+        if (separator != std::string::npos)
+        {
+            value = key.substr(separator + 1);
+            key = key.substr(0, separator);
+        }
+        else if ((arg + 1 < argc) and (std::string(argv[arg + 1]).rfind("--", 0) != 0))
+        {
+            value = argv[++arg];
+        }
+        arguments.emplace_back(key, value);
+    }
+
+    for (const auto &argument : arguments)
+    {
+        if (argument.first == "config") read_file(argument.second);
+    }
+    for (const auto &argument : arguments)
+    {
+        if (argument.first != "config") set(argument.first, argument.second);
+    }
+}
+
+void Config::set(const std::string key, const std::string value)
+{
+    values[key] = value;
+}
+
+bool Config::contains(const std::string key) const
+{
+    return values.count(key) > 0;
+}
+
+const std::string *Config::find(const std::string key)
+{   /*
+    Value of 'key', or nullptr if it is not set. Marks the key as used.
+    */
+    used.insert(key);
+    const auto value = values.find(key);
+    if (value == values.end()) return nullptr;
+    return &value->second;
+}
+
+void Config::invalid_value(const std::string key, const std::string type)
+{
+    std::cout << "Parameter '" << key << "' = '" << values[key];
+    std::cout << "' is not a valid " << type << "! Exiting..." << std::endl;
+    exit(0);
+}
+
+std::string Config::get_string(const std::string key, const std::string default_value)
+{
+    const std::string *value = find(key);
+    return value ? *value : default_value;
+}
+
+double Config::get_double(const std::string key, const double default_value)
+{
+    const std::string *value = find(key);
+    if (!value) return default_value;
+
+    std::size_t length;
+    double result;
+    try {result = std::stod(*value, &length);}
+    catch (const std::exception &) {invalid_value(key, "number");}
+    if (length != value->size()) invalid_value(key, "number");
+    return result;
+}
+
+long Config::get_long(const std::string key, const long default_value)
+{   /*
+    Integer parameter. Powers may be written as "2^20".
+    */
+    const std::string *value = find(key);
+    if (!value) return default_value;
+
+    const std::size_t power = value->find('^');
+    std::size_t length;
+    long result;
+    try
+    {
+        if (power == std::string::npos)
+        {
+            result = std::stol(*value, &length);
+        }
+        else
+        {
+            const long base = std::stol(value->substr(0, power));
+            const long exponent = std::stol(value->substr(power + 1), &length);
+            length += power + 1;
+            const double power_value = std::pow(base, exponent);
+            if (!(std::abs(power_value) < std::numeric_limits<long>::max()))
+            {
+                invalid_value(key, "integer");
+            }
+            result = std::lround(power_value);
+        }
+    }
+    catch (const std::exception &) {invalid_value(key, "integer");}
+    if (length != value->size()) invalid_value(key, "integer");
+    return result;
+}
+
+int Config::get_int(const std::string key, const int default_value)
+{   /*
+    Integer parameter which fits in an int.
+    */
+    const long result = get_long(key, default_value);
+    if ((result < std::numeric_limits<int>::min()) or (result > std::numeric_limits<int>::max()))
+    {
+        invalid_value(key, "integer");
+    }
+    return static_cast<int>(result);
+}
+
+bool Config::get_bool(const std::string key, const bool default_value)
+{
+    const std::string *value = find(key);
+    if (!value) return default_value;
+
+    if ((*value == "1") or (*value == "true") or (*value == "yes")) return true;
+    if ((*value == "0") or (*value == "false") or (*value == "no")) return false;
+    invalid_value(key, "boolean");
+    return default_value;
+}
+
+std::vector<double> Config::get_list(const std::string key, const std::vector<double> default_value)
+{   /*
+    Comma separated list of numbers, e.g. "0.3, 0.4, 0.5".
+    */
+    const std::string *value = find(key);
+    if (!value) return default_value;
+
+    std::vector<double> result;
+    std::size_t start = 0;
+    while (start <= value->size())
+    {
+        std::size_t end = value->find(',', start);
+        if (end == std::string::npos) end = value->size();
+        const std::string element = trim(value->substr(start, end - start));
+
+        std::size_t length;
+        try {result.push_back(std::stod(element, &length));}
+        catch (const std::exception &) {invalid_value(key, "list of numbers");}
+        if (length != element.size()) invalid_value(key, "list of numbers");
+        start = end + 1;
+    }
+    return result;
+}
+
+void Config::check_unused()
+{   /*
+    Exit if any parameter was set but never read, which is most likely
+    a misspelled key.
+    */
+    bool unused = false;
+    for (const auto &value : values)
+    {
+        if (used.count(value.first) == 0)
+        {
+            std::cout << "Unknown parameter '" << value.first << "'." << std::endl;
+            unused = true;
+        }
+    }
+    if (unused)
+    {
+        std::cout << "Exiting..." << std::endl;
+        exit(0);
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef CONFIG
+#define CONFIG
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+class Config
+{   /*
+    Run parameters read from a config file and the command line.  A
+    config file has one "key = value" pair per line, and '#' starts a
+    comment.  On the command line, "--key value" or "--key=value" sets
+    a parameter and overrides the config file.  The typed getters return
+    a default for parameters which are not set.  Keys that were set but
+    never read are reported by check_unused, to catch misspellings.
+    */
+    private:
+        std::map<std::string, std::string> values;
+        std::set<std::string> used;
+
+        const std::string *find(const std::string key);
+        [[noreturn]] void invalid_value(const std::string key, const std::string type);
+
+    public:
+        void read_file(const std::string fpath);
+        void read_arguments(int argc, char *argv[]);
+        void set(const std::string key, const std::string value);
+        bool contains(const std::string key) const;
+
+        std::string get_string(const std::string key, const std::string default_value);
+        double get_double(const std::string key, const double default_value);
+        long get_long(const std::string key, const long default_value);
+        int get_int(const std::string key, const int default_value);
+        bool get_bool(const std::string key, const bool default_value);
+        std::vector<double> get_list(const std::string key, const std::vector<double> default_value);
+        void check_unused();
+};
+
+#endif
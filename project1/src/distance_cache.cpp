@@ -0,0 +1,159 @@
+#include "distance_cache.h"
+
+DistanceCache::DistanceCache() : n_particles(0), n_dims(0), moved_particle(0)
+{
+}
+
+DistanceCache::DistanceCache(const int n_particles_input, const int n_dims_input) :
+    n_particles(n_particles_input),
+    n_dims(n_dims_input),
+    moved_particle(0)
+{   /*
+    Class constructor.
+
+    Parameters
+    ----------
+    n_particles_input : constant integer
+        The number of particles.
+
+    n_dims_input : constant integer
+        The number of spatial dimensions.
+    */
+    const int n_padded = (n_particles + simd_width - 1)/simd_width*simd_width;
+
+    positions = arma::Mat<double>(n_padded, n_dims);
+    distance = arma::Mat<double>(n_particles, n_particles);
+    distance_previous = arma::Col<double>(n_particles);
+    positions.zeros();
+    distance.zeros();
+    distance_previous.zeros();
+}
+
+template <int dims>
+void DistanceCache::update_column(const int particle)
+{   /*
+    Recalculate column 'particle' of 'distance' from 'positions'. The
+    diagonal element is 0 since the difference vanishes.
+
+    Parameters
+    ----------
+    particle : constant integer
+        Index of the particle.
+    */
+    // Unused dimensions point to x, and are skipped at compile time.
+    const double *x_all = positions.colptr(0);
+    const double *y_all = (dims > 1) ? positions.colptr(1) : x_all;
+    const double *z_all = (dims > 2) ? positions.colptr(2) : x_all;
+    const double x = x_all[particle];
+    const double y = y_all[particle];
+    const double z = z_all[particle];
+    double *column = distance.colptr(particle);
+
+    #pragma omp simd
+    for (int particle_inner = 0; particle_inner < n_particles; particle_inner++)
+    {
+        const double diff_x = x - x_all[particle_inner];
+        double particle_distance = diff_x*diff_x;
+        if (dims > 1)
+        {
+            const double diff_y = y - y_all[particle_inner];
+            particle_distance += diff_y*diff_y;
+        }
+        if (dims > 2)
+        {
+            const double diff_z = z - z_all[particle_inner];
+            particle_distance += diff_z*diff_z;
+        }
+        column[particle_inner] = std::sqrt(particle_distance);
+    }
+}
+
+void DistanceCache::update_column_dispatch(const int particle)
+{   /*
+    Call update_column for the number of dimensions of this cache.
+    */
+    if (n_dims == 1) update_column<1>(particle);
+    else if (n_dims == 2) update_column<2>(particle);
+    else update_column<3>(particle);
+}
+
+void DistanceCache::compute(const arma::Mat<double> &pos)
+{   /*
+    Copy all positions and calculate all pairwise distances from
+    scratch.
+
+    Parameters
+    ----------
+    pos : arma::Mat<double> reference
+        Positions of all particles. n_dims x N.
+    */
+    for (int particle = 0; particle < n_particles; particle++)
+    {
+        for (int dim = 0; dim < n_dims; dim++)
+        {
+            positions(particle, dim) = pos(dim, particle);
+        }
+    }
+
+    for (int particle = 0; particle < n_particles; particle++)
+    {
+        update_column_dispatch(particle);
+    }
+}
+
+void DistanceCache::move(const arma::Mat<double> &pos, const int particle)
+{   /*
+    Update the position, row and column of a single moved particle. The
+    old distances are stored in 'distance_previous' until the next move.
+
+    Parameters
+    ----------
+    pos : arma::Mat<double> reference
+        Positions of all particles, where 'particle' is at its new
+        position. n_dims x N.
+
+    particle : constant integer
+        Index of the moved particle.
+    */
+    double *column = distance.colptr(particle);
+    double *previous = distance_previous.memptr();
+
+    moved_particle = particle;
+
+    for (int particle_inner = 0; particle_inner < n_particles; particle_inner++)
+    {
+        previous[particle_inner] = column[particle_inner];
+    }
+    for (int dim = 0; dim < n_dims; dim++)
+    {
+        position_previous[dim] = positions(particle, dim);
+        positions(particle, dim) = pos(dim, particle);
+    }
+
+    update_column_dispatch(particle);
+
+    for (int particle_inner = 0; particle_inner < n_particles; particle_inner++)
+    {   /*
+        Mirror the new column into the row.
+        */
+        distance(particle, particle_inner) = column[particle_inner];
+    }
+}
+
+void DistanceCache::reject()
+{   /*
+    Roll back the previous call to 'move'.
+    */
+    double *column = distance.colptr(moved_particle);
+    const double *previous = distance_previous.memptr();
+
+    for (int dim = 0; dim < n_dims; dim++)
+    {
+        positions(moved_particle, dim) = position_previous[dim];
+    }
+    for (int particle_inner = 0; particle_inner < n_particles; particle_inner++)
+    {
+        column[particle_inner] = previous[particle_inner];
+        distance(moved_particle, particle_inner) = previous[particle_inner];
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef DISTANCE_CACHE
+#define DISTANCE_CACHE
+
+#include <cmath>
+#include <armadillo>
+
+class DistanceCache
+{   /*
+    Pairwise particle distances |r_i - r_j| for one walker.  When a
+    single particle is moved, only its row and column are recalculated.
+    The previous column is kept so that the move can be rolled back if
+    it is rejected by the Metropolis test.
+
+    The cache also holds a copy of the positions in structure-of-arrays
+    layout, which follows every move.  Column 'dim' of 'positions' holds
+    coordinate 'dim' of all particles contiguously, so that the pair
+    loops over particles in the kernels can be vectorized.  Kernels
+    should read the distances of particle k from column k of 'distance',
+    which is contiguous, rather than from row k.
+    */
+    private:
+        int n_particles;
+        int n_dims;
+        int moved_particle;
+        double position_previous[3];    // Position of 'moved_particle' before the move.
+
+        template <int dims>
+        void update_column(const int particle);
+        void update_column_dispatch(const int particle);
+
+    public:
+        static const int simd_width = 8;        // Pad 'positions' to a multiple of this.
+        arma::Mat<double> positions;            // n_padded x n_dims. Positions, one column per dimension.
+        arma::Mat<double> distance;             // Symmetric NxN distance matrix.
+        arma::Col<double> distance_previous;    // Column of 'moved_particle' before the move.
+
+        DistanceCache();
+        DistanceCache(const int n_particles_input, const int n_dims_input);
+        void compute(const arma::Mat<double> &pos);
+        void move(const arma::Mat<double> &pos, const int particle);
+        void reject();
+};
+
+#endif
@@ -0,0 +1,145 @@
+#include "distributed.h"
+#include <cstring>
+#include <algorithm>
+
+#ifdef USE_MPI
+    #include <mpi.h>
+#endif
+
+// Set once by distributed_init, so that the rank and size may be read
+// from any thread without calling MPI.
+static int rank_cached = 0;
+static int size_cached = 1;
+
+void distributed_init(int &argc, char **&argv)
+{   /*
+    Start the distributed run. Call first in main.
+    */
+    #ifdef USE_MPI
+        int provided;
+        MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank_cached);
+        MPI_Comm_size(MPI_COMM_WORLD, &size_cached);
+    #endif
+}
+
+void distributed_finalize()
+{
+    #ifdef USE_MPI
+        MPI_Finalize();
+    #endif
+}
+
+int distributed_rank()
+{
+    return rank_cached;
+}
+
+int distributed_size()
+{
+    return size_cached;
+}
+
+bool distributed_root()
+{   /*
+    True on the rank which prints and writes the output files.
+    */
+    return distributed_rank() == 0;
+}
+
+static void range_of_rank(const int n_items, const int rank, const int size, int &begin, int &end)
+{
+    const int items_per_rank = n_items/size;
+    const int items_remainder = n_items%size;
+    begin = rank*items_per_rank + std::min(rank, items_remainder);
+    end = begin + items_per_rank + (rank < items_remainder);
+}
+
+void distributed_range(const int n_items, int &begin, int &end)
+{   /*
+    The contiguous block [begin, end) of 'n_items' items which belongs
+    to this rank. The first n_items%size ranks get one extra item.
+
+    Parameters
+    ----------
+    n_items : constant integer
+        Total number of items of all ranks.
+
+    begin : integer reference
+        First item of this rank.
+
+    end : integer reference
+        One past the last item of this rank.
+    */
+    range_of_rank(n_items, distributed_rank(), distributed_size(), begin, end);
+}
+
+void distributed_all_gather(const void *local, void *global, const int item_bytes, const int n_items)
+{   /*
+    Gather the items of all ranks, in rank order, into 'global' on every
+    rank.  Items are copied as raw bytes.
+
+    Parameters
+    ----------
+    local : constant void pointer
+        The items of this rank, see distributed_range.
+
+    global : void pointer
+        Room for 'n_items' items.
+
+    item_bytes : constant integer
+        Size of one item.
+
+    n_items : constant integer
+        Total number of items of all ranks.
+    */
+    int begin;
+    int end;
+    distributed_range(n_items, begin, end);
+
+    #ifdef USE_MPI
+        const int size = distributed_size();
+        std::vector<int> counts(size);
+        std::vector<int> displacements(size);
+        for (int rank = 0; rank < size; rank++)
+        {
+            int rank_begin;
+            int rank_end;
+            range_of_rank(n_items, rank, size, rank_begin, rank_end);
+            counts[rank] = (rank_end - rank_begin)*item_bytes;
+            displacements[rank] = rank_begin*item_bytes;
+        }
+        MPI_Allgatherv(
+            local, (end - begin)*item_bytes, MPI_BYTE,
+            global, counts.data(), displacements.data(), MPI_BYTE,
+            MPI_COMM_WORLD
+        );
+    #else
+        std::memcpy(global, local, static_cast<std::size_t>(end - begin)*item_bytes);
+    #endif
+}
+
+void distributed_sum(double *values, const int n_values)
+{   /*
+    Replace 'values' on every rank by the sum over all ranks.
+    */
+    #ifdef USE_MPI
+        MPI_Allreduce(MPI_IN_PLACE, values, n_values, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    #endif
+}
+
+void distributed_broadcast(double &value)
+{   /*
+    Set 'value' on every rank to the value on the root rank.
+    */
+    #ifdef USE_MPI
+        MPI_Bcast(&value, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    #endif
+}
+
+void distributed_broadcast(long &value)
+{
+    #ifdef USE_MPI
+        MPI_Bcast(&value, 1, MPI_LONG, 0, MPI_COMM_WORLD);
+    #endif
+}
@@ -0,0 +1,43 @@
+#ifndef DISTRIBUTED
+#define DISTRIBUTED
+
+#include <vector>
+#include <type_traits>
+
+/*
+Communication between the processes (ranks) of a distributed run.  With
+-DUSE_MPI, distributed.cpp is built on MPI, see the 'mpi' make target.
+Without it, there is a single rank and all functions are no-ops, so the
+rest of the code does not need to know how it is run.
+
+The walkers of a variation are divided between the ranks in contiguous
+blocks, see distributed_range.  Every rank gathers the accumulators of
+all walkers and sums them in walker order, so all ranks get the same,
+bit-identical result as a single process with the same seed and number
+of walkers.
+*/
+
+void distributed_init(int &argc, char **&argv);
+void distributed_finalize();
+int distributed_rank();
+int distributed_size();
+bool distributed_root();
+void distributed_range(const int n_items, int &begin, int &end);
+void distributed_all_gather(const void *local, void *global, const int item_bytes, const int n_items);
+void distributed_sum(double *values, const int n_values);
+void distributed_broadcast(double &value);
+void distributed_broadcast(long &value);
+
+template <class T>
+std::vector<T> distributed_all_gather(const std::vector<T> &local, const int n_items)
+{   /*
+    Gather the items of all ranks. 'local' holds the items of this rank,
+    items distributed_range(n_items) of the result.
+    */
+    static_assert(std::is_trivially_copyable<T>::value, "Gathered items must be trivially copyable.");
+    std::vector<T> global(n_items);
+    distributed_all_gather(local.data(), global.data(), sizeof(T), n_items);
+    return global;
+}
+
+#endif
@@ -0,0 +1,166 @@
+#include "energy_sink.h"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <limits>
+
+MemorySink::MemorySink(const std::string fpath_input) : fpath(fpath_input)
+{   /*
+    Class constructor.
+
+    Parameters
+    ----------
+    fpath_input : constant std::string
+        Text file written by finish. Empty for no file.
+    */
+}
+
+void MemorySink::begin_variation(
+    const int variation,
+    const double alpha,
+    const int n_walkers,
+    const std::string &metadata
+)
+{   /*
+    Start collecting the energies of 'variation'.
+    */
+    walker_values = std::vector<WalkerValues>(n_walkers);
+    if (static_cast<int>(energies.size()) <= variation)
+    {
+        energies.resize(variation + 1);
+        alphas.resize(variation + 1);
+    }
+    alphas[variation] = alpha;
+    current_variation = variation;
+}
+
+void MemorySink::end_variation()
+{   /*
+    Concatenate the walker energies in walker order.
+    */
+    arma::uword n_values = 0;
+    for (const WalkerValues &walker : walker_values) n_values += walker.values.size();
+
+    arma::Col<double> &column = energies[current_variation];
+    column.set_size(n_values);
+    arma::uword row = 0;
+    for (const WalkerValues &walker : walker_values)
+    {
+        for (const double value : walker.values) column(row++) = value;
+    }
+    walker_values.clear();
+}
+
+void MemorySink::finish()
+{   /*
+    Write all energies to 'fpath' as text.
+    */
+    if (fpath.empty() or energies.empty()) return;
+
+    arma::uword n_rows = 0;
+    for (const arma::Col<double> &column : energies) n_rows = std::max(n_rows, column.n_elem);
+
+    arma::Mat<double> energies_out(n_rows, energies.size());
+    energies_out.fill(std::numeric_limits<double>::quiet_NaN());
+    for (arma::uword variation = 0; variation < energies.size(); variation++)
+    {
+        for (arma::uword row = 0; row < energies[variation].n_elem; row++)
+        {
+            energies_out(row, variation) = energies[variation](row);
+        }
+    }
+
+    std::ofstream outfile(fpath, std::ios::out);
+    outfile << "alphas" << "\n";
+    for (const double alpha : alphas)
+    {
+        outfile << std::setw(20) << std::setprecision(10);
+        outfile << alpha;
+    }
+    outfile << "\n";
+    energies_out.save(outfile, arma::raw_ascii);
+    outfile.close();
+    std::cout << fpath << " written to file." << std::endl;
+}
+
+FileSink::FileSink(const std::string fpath_input, const bool single_precision_input) :
+    fpath(fpath_input),
+    single_precision(single_precision_input)
+{   /*
+    Class constructor. The file is created by the first variation.
+
+    Parameters
+    ----------
+    fpath_input : constant std::string
+        Binary energy file. See EnergyWriter for the format.
+
+    single_precision_input : constant boolean
+        Write float32 instead of float64 energies.
+    */
+}
+
+void FileSink::begin_variation(
+    const int variation,
+    const double alpha,
+    const int n_walkers,
+    const std::string &metadata
+)
+{   /*
+    Open the file with 'metadata' as header on the first call, and start
+    a new variation.
+    */
+    if (!writer.is_open()) writer.open(fpath, metadata, n_walkers, single_precision);
+    writer.begin_variation(variation, alpha);
+}
+
+void FileSink::end_variation()
+{
+    writer.end_variation();
+}
+
+void FileSink::finish()
+{
+    if (writer.is_open())
+    {
+        writer.close();
+        std::cout << fpath << " written to file." << std::endl;
+    }
+}
+
+DecimatedSink::DecimatedSink(std::unique_ptr<EnergySink> target_input, const int stride_input) :
+    target(std::move(target_input)),
+    stride(stride_input)
+{   /*
+    Class constructor.
+
+    Parameters
+    ----------
+    target_input : std::unique_ptr<EnergySink>
+        Sink which receives the kept energies.
+
+    stride_input : constant integer
+        Keep every 'stride_input'-th energy of each walker.
+    */
+}
+
+void DecimatedSink::begin_variation(
+    const int variation,
+    const double alpha,
+    const int n_walkers,
+    const std::string &metadata
+)
+{
+    counts = std::vector<WalkerCount>(n_walkers);
+    target->begin_variation(variation, alpha, n_walkers, metadata + "decimation=" + std::to_string(stride) + "\n");
+}
+
+void DecimatedSink::end_variation()
+{
+    target->end_variation();
+}
+
+void DecimatedSink::finish()
+{
+    target->finish();
+}
@@ -0,0 +1,123 @@
+#ifndef ENERGY_SINK
+#define ENERGY_SINK
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <armadillo>
+#include "energy_writer.h"
+
+class EnergySink
+{   /*
+    Receives the local energy of every sampled MC cycle.  The sampler
+    calls begin_variation and end_variation outside of the parallel
+    region, and add from the walkers, concurrently for different
+    walkers.  Set with VMC::set_energy_sink.  Without a sink, only the
+    blocking analysis of the walkers is kept.
+    */
+    public:
+        virtual ~EnergySink() {}
+        virtual void begin_variation(
+            const int variation,
+            const double alpha,
+            const int n_walkers,
+            const std::string &metadata
+        ) {}
+        virtual void add(const int walker, const double value) = 0;
+        virtual void end_variation() {}
+        virtual void finish() {}
+};
+
+class MemorySink : public EnergySink
+{   /*
+    Keep all energies in memory. Memory use grows with the number of
+    cycles.  finish writes them as text in the layout of the old
+    energies file: the alphas, then one column per variation with the
+    cycles of walker 0 first.  Shorter columns are padded with NaN.
+    */
+    private:
+        struct alignas(64) WalkerValues     // Own cache line per walker.
+        {
+            std::vector<double> values;
+        };
+
+        const std::string fpath;
+        std::vector<WalkerValues> walker_values;
+        std::vector<double> alphas;
+        int current_variation = 0;
+
+    public:
+        std::vector<arma::Col<double>> energies;    // One column per variation.
+
+        MemorySink(const std::string fpath_input);
+        void begin_variation(
+            const int variation,
+            const double alpha,
+            const int n_walkers,
+            const std::string &metadata
+        );
+        void add(const int walker, const double value)
+        {
+            walker_values[walker].values.push_back(value);
+        }
+        void end_variation();
+        void finish();
+};
+
+class FileSink : public EnergySink
+{   /*
+    Stream the energies to a binary file with EnergyWriter. Memory use
+    does not depend on the number of cycles.
+    */
+    private:
+        const std::string fpath;
+        const bool single_precision;
+        EnergyWriter writer;
+
+    public:
+        FileSink(const std::string fpath_input, const bool single_precision_input);
+        void begin_variation(
+            const int variation,
+            const double alpha,
+            const int n_walkers,
+            const std::string &metadata
+        );
+        void add(const int walker, const double value)
+        {
+            writer.add(walker, value);
+        }
+        void end_variation();
+        void finish();
+};
+
+class DecimatedSink : public EnergySink
+{   /*
+    Pass every 'stride'-th energy of each walker on to another sink.
+    */
+    private:
+        struct alignas(64) WalkerCount      // Own cache line per walker.
+        {
+            long count = 0;
+        };
+
+        std::unique_ptr<EnergySink> target;
+        const int stride;
+        std::vector<WalkerCount> counts;
+
+    public:
+        DecimatedSink(std::unique_ptr<EnergySink> target_input, const int stride_input);
+        void begin_variation(
+            const int variation,
+            const double alpha,
+            const int n_walkers,
+            const std::string &metadata
+        );
+        void add(const int walker, const double value)
+        {
+            if (counts[walker].count++ % stride == 0) target->add(walker, value);
+        }
+        void end_variation();
+        void finish();
+};
+
+#endif
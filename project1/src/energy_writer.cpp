@@ -0,0 +1,131 @@
+#include "energy_writer.h"
+#include <iostream>
+#include <cstdlib>
+
+EnergyWriter::EnergyWriter()
+{   /*
+    Class constructor. Nothing is written before open is called.
+    */
+}
+
+void EnergyWriter::open(
+    const std::string fpath,
+    const std::string header,
+    const int n_walkers,
+    const bool single_precision_input
+)
+{   /*
+    Create the file and write the magic string and header.
+
+    Parameters
+    ----------
+    fpath : constant std::string
+        Relative file path and name.
+
+    header : constant std::string
+        Run metadata as "key=value" lines. The byte order and value
+        size are appended.
+
+    n_walkers : constant integer
+        Number of walkers. Walker indices passed to add must be smaller.
+
+    single_precision_input : constant boolean
+        Write the energies as float32 instead of float64.
+    */
+    single_precision = single_precision_input;
+
+    const std::uint16_t byte_order_test = 1;
+    const bool little_endian = *reinterpret_cast<const unsigned char*>(&byte_order_test) == 1;
+
+    std::string header_text = header;
+    header_text += "byte_order=";
+    header_text += little_endian ? "little\n" : "big\n";
+    header_text += "value_bytes=";
+    header_text += single_precision ? "4\n" : "8\n";
+    const std::uint32_t header_length = header_text.size();
+
+    outfile.open(fpath, std::ios::out | std::ios::binary);
+    if (!outfile)
+    {
+        std::cout << "Could not open " << fpath << " for writing! Exiting..." << std::endl;
+        exit(0);
+    }
+    outfile.write("VMCENRG1", 8);
+    outfile.write(reinterpret_cast<const char*>(&header_length), sizeof(header_length));
+    outfile.write(header_text.data(), header_length);
+
+    buffers = std::vector<WalkerBuffer>(n_walkers);
+    for (WalkerBuffer &buffer : buffers) buffer.values.resize(chunk_size);
+    file_open = true;
+}
+
+void EnergyWriter::begin_variation(const int variation_input, const double alpha_input)
+{   /*
+    Start a new variation. Call outside of the parallel region.
+    */
+    variation = variation_input;
+    alpha = alpha_input;
+    for (WalkerBuffer &buffer : buffers)
+    {
+        buffer.n_values = 0;
+        buffer.first_cycle = 0;
+    }
+}
+
+void EnergyWriter::end_variation()
+{   /*
+    Write the partly filled buffers in walker order and flush the file.
+    Call outside of the parallel region.
+    */
+    for (int walker = 0; walker < static_cast<int>(buffers.size()); walker++)
+    {
+        if (buffers[walker].n_values > 0) write_chunk(walker);
+    }
+    outfile.flush();
+}
+
+void EnergyWriter::close()
+{   /*
+    Close the file. Buffered values which have not been written by
+    end_variation are lost.
+    */
+    if (file_open) outfile.close();
+    file_open = false;
+}
+
+void EnergyWriter::write_chunk(const int walker)
+{   /*
+    Write the buffer of 'walker' as one chunk and empty the buffer.
+    Only the file access is serialized between threads.
+    */
+    WalkerBuffer &buffer = buffers[walker];
+    const std::int32_t variation_out = variation;
+    const std::int32_t walker_out = walker;
+    const std::int64_t n_values_out = buffer.n_values;
+
+    std::vector<float> values_single;
+    if (single_precision)
+    {
+        values_single.assign(buffer.values.begin(), buffer.values.begin() + buffer.n_values);
+    }
+
+    #pragma omp critical(energy_writer)
+    {
+        outfile.write(reinterpret_cast<const char*>(&variation_out), sizeof(variation_out));
+        outfile.write(reinterpret_cast<const char*>(&walker_out), sizeof(walker_out));
+        outfile.write(reinterpret_cast<const char*>(&alpha), sizeof(alpha));
+        outfile.write(reinterpret_cast<const char*>(&buffer.first_cycle), sizeof(buffer.first_cycle));
+        outfile.write(reinterpret_cast<const char*>(&n_values_out), sizeof(n_values_out));
+        if (single_precision)
+        {
+            outfile.write(reinterpret_cast<const char*>(values_single.data()), n_values_out*sizeof(float));
+        }
+        else
+        {
+            outfile.write(reinterpret_cast<const char*>(buffer.values.data()), n_values_out*sizeof(double));
+        }
+    }
+
+    buffer.first_cycle += buffer.n_values;
+    buffer.n_values = 0;
+}
@@ -0,0 +1,78 @@
+#ifndef ENERGY_WRITER
+#define ENERGY_WRITER
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+class EnergyWriter
+{   /*
+    Streaming binary output of the local energy of every sampled cycle.
+    Every walker fills its own buffer, and a full buffer is written to
+    the file as one chunk, so memory use does not grow with the number
+    of cycles.
+
+    File layout:
+
+        char[8]     "VMCENRG1"
+        uint32      Length of the header text in bytes.
+        char[]      Header text, "key=value" lines with the run metadata,
+                    the byte order and the size of the values.
+        Chunks until the end of the file:
+            int32       variation
+            int32       walker
+            float64     alpha
+            int64       Index of the first cycle of the chunk within the
+                        walker and variation.
+            int64       n_values
+            n_values float64 (or float32) local energies.
+
+    All numbers are in the byte order given in the header.  Chunks of
+    different walkers are interleaved in the order they fill up.  See
+    read_energies_binary in scripts/read_from_file.py.
+    */
+    public:
+        static const int chunk_size = 8192;    // Values per chunk.
+
+        EnergyWriter();
+        void open(
+            const std::string fpath,
+            const std::string header,
+            const int n_walkers,
+            const bool single_precision
+        );
+        bool is_open() const {return file_open;}
+        void begin_variation(const int variation_input, const double alpha_input);
+        void end_variation();
+        void close();
+
+        void add(const int walker, const double value)
+        {   /*
+            Buffer 'value' for 'walker'. Safe to call concurrently for
+            different walkers.
+            */
+            WalkerBuffer &buffer = buffers[walker];
+            buffer.values[buffer.n_values++] = value;
+            if (buffer.n_values == chunk_size) write_chunk(walker);
+        }
+
+    private:
+        struct alignas(64) WalkerBuffer     // Own cache line per walker.
+        {
+            std::vector<double> values;
+            int n_values = 0;
+            std::int64_t first_cycle = 0;
+        };
+
+        std::ofstream outfile;
+        bool file_open = false;
+        bool single_precision = false;
+        int variation = 0;
+        double alpha = 0;
+        std::vector<WalkerBuffer> buffers;
+
+        void write_chunk(const int walker);
+};
+
+#endif
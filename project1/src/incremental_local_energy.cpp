@@ -0,0 +1,270 @@
+#include "incremental_local_energy.h"
+
+IncrementalLocalEnergy::IncrementalLocalEnergy() :
+    n_particles(0),
+    alpha(0),
+    beta(0),
+    local_energy(0)
+{
+}
+
+IncrementalLocalEnergy::IncrementalLocalEnergy(const int n_particles_input) :
+    n_particles(n_particles_input),
+    alpha(0),
+    beta(0),
+    local_energy(0)
+{   /*
+    Class constructor.
+
+    Parameters
+    ----------
+    n_particles_input : constant integer
+        The number of particles.
+    */
+    jastrow_gradient = arma::Mat<double>(n_particles, 3);
+    jastrow_laplacian = arma::Col<double>(n_particles);
+    jastrow_gradient.zeros();
+    jastrow_laplacian.zeros();
+}
+
+inline void IncrementalLocalEnergy::pair_terms(
+    const double particle_distance,
+    double &u_diff_1_over_r,
+    double &laplacian
+)
+{   /*
+    Contribution of a single pair to the Jastrow gradient and Laplacian
+    sums.  Branch-free so that the loops calling it vectorize.
+
+    Parameters
+    ----------
+    particle_distance : constant double
+        The particle spacing r.
+
+    u_diff_1_over_r : double reference
+        Is set to u'(r)/r.  Multiply with the displacement vector to get
+        the gradient contribution.
+
+    laplacian : double reference
+        Is set to u''(r) + 2u'(r)/r.
+    */
+    // Interaction if the particle spacing is greater than 'a'. A particle
+    // paired with itself has spacing 0 and thus adds nothing.
+    const bool interacting = particle_distance > a;
+    const double r = interacting ? particle_distance : 2*a;     // Keep the unused result finite.
+    const double u_diff_1 = a/(r*(r - a));
+    const double u_diff_2 = (a*a - 2*a*r)/(r*r*(r - a)*(r - a));
+
+    u_diff_1_over_r = interacting ? u_diff_1/r : 0;
+    laplacian = interacting ? u_diff_2 + 2*u_diff_1/r : 0;
+}
+
+void IncrementalLocalEnergy::assemble(const DistanceCache &distances)
+{   /*
+    Sum the local energy of all particles from the stored Jastrow
+    gradients and Laplacians. O(N).
+    */
+    const double *x_all = distances.positions.colptr(0);
+    const double *y_all = distances.positions.colptr(1);
+    const double *z_all = distances.positions.colptr(2);
+    const double *gradient_x = jastrow_gradient.colptr(0);
+    const double *gradient_y = jastrow_gradient.colptr(1);
+    const double *gradient_z = jastrow_gradient.colptr(2);
+    const double *laplacian = jastrow_laplacian.memptr();
+
+    double term_1 = 0;
+    double term_2 = 0;
+    double term_3 = 0;
+    double term_4 = 0;
+    double potential = 0;
+
+    #pragma omp simd reduction(+:term_1, term_2, term_3, term_4, potential)
+    for (int particle = 0; particle < n_particles; particle++)
+    {
+        const double x = x_all[particle];
+        const double y = y_all[particle];
+        const double z = z_all[particle];
+
+        term_1 += -2*alpha*(2 - 2*alpha*(x*x + y*y + beta*beta*z*z) + beta);
+        term_2 += -2*2*alpha*(
+            x*gradient_x[particle] +
+            y*gradient_y[particle] +
+            beta*z*gradient_z[particle]
+        );
+        term_3 +=
+            gradient_x[particle]*gradient_x[particle] +
+            gradient_y[particle]*gradient_y[particle] +
+            gradient_z[particle]*gradient_z[particle];
+        term_4 += laplacian[particle];
+        potential += (x*x + y*y)*omega*omega + z*z*omega_z*omega_z;
+    }
+
+    local_energy = -hbar*hbar/(2*m)*(term_1 + term_2 + term_3 + term_4) + 0.5*m*potential;
+}
+
+void IncrementalLocalEnergy::initialize(
+    const arma::Mat<double> &pos,
+    const DistanceCache &distances,
+    const double alpha_input,
+    const double beta_input
+)
+{   /*
+    Calculate all Jastrow sums from scratch. O(N^2).  Call at the start
+    of a variation, and now and then during the run to get rid of the
+    round-off accumulated by 'move'.
+
+    Parameters
+    ----------
+    pos : arma::Mat<double> reference
+        Positions of all particles. 3xN.
+
+    distances : DistanceCache reference
+        Pairwise distances and structure-of-arrays positions of all
+        particles in 'pos'.
+
+    alpha_input : constant double
+        Variational parameter.
+
+    beta_input : constant double
+        ???
+    */
+    const double *x_all = distances.positions.colptr(0);
+    const double *y_all = distances.positions.colptr(1);
+    const double *z_all = distances.positions.colptr(2);
+    double *gradient_x = jastrow_gradient.colptr(0);
+    double *gradient_y = jastrow_gradient.colptr(1);
+    double *gradient_z = jastrow_gradient.colptr(2);
+    double *laplacian_all = jastrow_laplacian.memptr();
+
+    alpha = alpha_input;
+    beta = beta_input;
+
+    for (int particle = 0; particle < n_particles; particle++)
+    {   /*
+        Particle 'particle' gets the sum over all other particles. The
+        column of the distance matrix is contiguous.
+        */
+        const double *distance_column = distances.distance.colptr(particle);
+        const double x = x_all[particle];
+        const double y = y_all[particle];
+        const double z = z_all[particle];
+        double sum_x = 0;
+        double sum_y = 0;
+        double sum_z = 0;
+        double sum_laplacian = 0;
+
+        #pragma omp simd reduction(+:sum_x, sum_y, sum_z, sum_laplacian)
+        for (int particle_inner = 0; particle_inner < n_particles; particle_inner++)
+        {
+            double u_diff_1_over_r;
+            double laplacian;
+            pair_terms(distance_column[particle_inner], u_diff_1_over_r, laplacian);
+
+            sum_x += u_diff_1_over_r*(x - x_all[particle_inner]);
+            sum_y += u_diff_1_over_r*(y - y_all[particle_inner]);
+            sum_z += u_diff_1_over_r*(z - z_all[particle_inner]);
+            sum_laplacian += laplacian;
+        }
+        gradient_x[particle] = sum_x;
+        gradient_y[particle] = sum_y;
+        gradient_z[particle] = sum_z;
+        laplacian_all[particle] = sum_laplacian;
+    }
+    assemble(distances);
+}
+
+void IncrementalLocalEnergy::move(
+    const arma::Mat<double> &pos_current,
+    const arma::Mat<double> &pos_new,
+    const DistanceCache &distances,
+    const int particle
+)
+{   /*
+    Update the local energy after 'particle' has been moved and the move
+    was accepted. O(N).  Must be called before 'pos_current' is
+    overwritten with the new position.
+
+    Parameters
+    ----------
+    pos_current : arma::Mat<double> reference
+        Positions of all particles before the move.
+
+    pos_new : arma::Mat<double> reference
+        Positions of all particles after the move.  Only column
+        'particle' differs from 'pos_current'.
+
+    distances : DistanceCache reference
+        Distance cache updated by DistanceCache::move for 'particle', so
+        that 'distance' holds the new and 'distance_previous' the old
+        spacings, and 'positions' the new positions.
+
+    particle : constant integer
+        Index of the moved particle.
+    */
+    const double *x_all = distances.positions.colptr(0);   // Only 'particle' differs from pos_current.
+    const double *y_all = distances.positions.colptr(1);
+    const double *z_all = distances.positions.colptr(2);
+    const double *distance_new = distances.distance.colptr(particle);
+    const double *distance_current = distances.distance_previous.memptr();
+    double *gradient_x = jastrow_gradient.colptr(0);
+    double *gradient_y = jastrow_gradient.colptr(1);
+    double *gradient_z = jastrow_gradient.colptr(2);
+    double *laplacian_all = jastrow_laplacian.memptr();
+
+    const double x_current = pos_current(0, particle);
+    const double y_current = pos_current(1, particle);
+    const double z_current = pos_current(2, particle);
+    const double x_new = pos_new(0, particle);
+    const double y_new = pos_new(1, particle);
+    const double z_new = pos_new(2, particle);
+
+    double sum_x = 0;
+    double sum_y = 0;
+    double sum_z = 0;
+    double sum_laplacian = 0;
+
+    #pragma omp simd reduction(+:sum_x, sum_y, sum_z, sum_laplacian)
+    for (int particle_inner = 0; particle_inner < n_particles; particle_inner++)
+    {   /*
+        Particle 'particle_inner' holds -(pair term), so the old term is
+        added back and the new one subtracted. The pair of 'particle'
+        with itself adds nothing, and its own sums are overwritten
+        below.
+        */
+        double u_diff_1_over_r_current;
+        double u_diff_1_over_r_new;
+        double laplacian_current;
+        double laplacian_new;
+
+        pair_terms(distance_current[particle_inner], u_diff_1_over_r_current, laplacian_current);
+        pair_terms(distance_new[particle_inner], u_diff_1_over_r_new, laplacian_new);
+
+        const double diff_x_new = u_diff_1_over_r_new*(x_new - x_all[particle_inner]);
+        const double diff_y_new = u_diff_1_over_r_new*(y_new - y_all[particle_inner]);
+        const double diff_z_new = u_diff_1_over_r_new*(z_new - z_all[particle_inner]);
+
+        gradient_x[particle_inner] +=
+            u_diff_1_over_r_current*(x_current - x_all[particle_inner]) - diff_x_new;
+        gradient_y[particle_inner] +=
+            u_diff_1_over_r_current*(y_current - y_all[particle_inner]) - diff_y_new;
+        gradient_z[particle_inner] +=
+            u_diff_1_over_r_current*(z_current - z_all[particle_inner]) - diff_z_new;
+        laplacian_all[particle_inner] += laplacian_new - laplacian_current;
+
+        sum_x += diff_x_new;
+        sum_y += diff_y_new;
+        sum_z += diff_z_new;
+        sum_laplacian += laplacian_new;
+    }
+    gradient_x[particle] = sum_x;
+    gradient_y[particle] = sum_y;
+    gradient_z[particle] = sum_z;
+    laplacian_all[particle] = sum_laplacian;
+
+    assemble(distances);
+}
+
+double IncrementalLocalEnergy::get_local_energy()
+{
+    return local_energy;
+}
@@ -0,0 +1,54 @@
+#ifndef INCREMENTAL_LOCAL_ENERGY
+#define INCREMENTAL_LOCAL_ENERGY
+
+#include <cmath>
+#include <armadillo>
+#include "distance_cache.h"
+#include "parameters.h"
+
+class IncrementalLocalEnergy
+{   /*
+    Total local energy for 3 dimensions with interaction, kept up to
+    date as single particles are moved.  The Jastrow gradient and
+    Laplacian sums of every particle are stored, so that moving one
+    particle only changes its N - 1 pair terms, and the total local
+    energy is updated in O(N) instead of recalculated in O(N^2).  The
+    gradients are stored in the same structure-of-arrays layout as
+    DistanceCache::positions, so that the loops over particles
+    vectorize.
+    */
+    private:
+        int n_particles;
+        double alpha;
+        double beta;
+        double local_energy;
+
+        arma::Mat<double> jastrow_gradient;     // sum_j u'(r_kj) (r_k - r_j)/r_kj. Nx3, one column per dimension.
+        arma::Col<double> jastrow_laplacian;    // sum_j u''(r_kj) + 2u'(r_kj)/r_kj.
+
+        void pair_terms(
+            const double particle_distance,
+            double &u_diff_1_over_r,
+            double &laplacian
+        );
+        void assemble(const DistanceCache &distances);
+
+    public:
+        IncrementalLocalEnergy();
+        IncrementalLocalEnergy(const int n_particles_input);
+        void initialize(
+            const arma::Mat<double> &pos,
+            const DistanceCache &distances,
+            const double alpha_input,
+            const double beta_input
+        );
+        void move(
+            const arma::Mat<double> &pos_current,
+            const arma::Mat<double> &pos_new,
+            const DistanceCache &distances,
+            const int particle
+        );
+        double get_local_energy();
+};
+
+#endif
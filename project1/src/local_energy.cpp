@@ -4,6 +4,7 @@
 
 double local_energy_3d_interaction_vala(
     const arma::Mat<double> &pos,
+    const DistanceCache &distances,
     const double alpha,
     const double beta,
     const int current_particle,
@@ -110,6 +111,7 @@ double local_energy_3d_interaction_vala(
 
 double local_energy_3d_interaction(
     const arma::Mat<double> &pos,
+    const DistanceCache &distances,
     const double alpha,
     const double beta,
     const int current_particle,
@@ -117,13 +119,16 @@ double local_energy_3d_interaction(
 )
 {   /*
     Analytical expression for the local energy for 3 dimensions, with
-    interaction between particles.
+    interaction between particles.  O(N), without temporary vectors.
 
     Parameters
     ----------
     pos : arma::Mat<double> reference
         Reference to position matrix of all particles. 3xN.
 
+    distances : DistanceCache reference
+        Pairwise distances of all particles in 'pos'.
+
     alpha : double
         Variational parameter.
 
@@ -136,366 +141,106 @@ double local_energy_3d_interaction(
     n_particles : constant integer
         The total number of particles.
     */
+    const double *x_all = distances.positions.colptr(0);   // Structure of arrays.
+    const double *y_all = distances.positions.colptr(1);
+    const double *z_all = distances.positions.colptr(2);
+    const double *distance_column = distances.distance.colptr(current_particle);
+
+    const double x = pos(0, current_particle);
+    const double y = pos(1, current_particle);
+    const double z = pos(2, current_particle);
 
-    int particle;   // Particle loop index.
-    int particle_inner;   // Particle loop index.
+    // Jastrow gradient sum_j u'(r_kj) (r_k - r_j)/r_kj, and Laplacian
+    // sum_j u''(r_kj) + 2u'(r_kj)/r_kj. Kept as scalars, since terms 2, 3
+    // and 4 only need these sums.
+    double gradient_x = 0;
+    double gradient_y = 0;
+    double gradient_z = 0;
+    double term_4 = 0;
+
+    #pragma omp simd reduction(+:gradient_x, gradient_y, gradient_z, term_4)
+    for (int particle = 0; particle < n_particles; particle++)
+    {   /*
+        Interaction if the particle spacing is greater than 'a'. This
+        also removes the particle itself, which has spacing 0.
+        Branch-free so that the loop vectorizes.
+        */
+        const bool interacting = distance_column[particle] > a;
+        const double particle_distance = interacting ? distance_column[particle] : 2*a;
+        const double u_diff_1_over_r = interacting ?
+            a/(particle_distance*particle_distance*(particle_distance - a)) : 0;    // u'(r_kj)/r_kj.
+        const double u_diff_2 = interacting ?
+            (a*a - 2*a*particle_distance)/(particle_distance*particle_distance*(particle_distance - a)*(particle_distance - a)) : 0;
+
+        gradient_x += u_diff_1_over_r*(x - x_all[particle]);
+        gradient_y += u_diff_1_over_r*(y - y_all[particle]);
+        gradient_z += u_diff_1_over_r*(z - z_all[particle]);
+        term_4 += u_diff_2 + 2*u_diff_1_over_r;
+    }
 
-    double x = pos(0, current_particle);
-    double y = pos(1, current_particle);
-    double z = pos(2, current_particle);
-    
     // Term 1.
     double term_1 = -2*alpha;
-    term_1 *= (2 - 2*alpha*(x*x + y*y + beta*beta*z*z) + beta*beta);
+    term_1 *= (2 - 2*alpha*(x*x + y*y + beta*beta*z*z) + beta);
     // Term 1 end.
 
     // Term 2.
-    double term_2 = -2*2*alpha;
-    double particle_distance_1;   // |r_k - r_j|.
-    arma::Col<double> term_2_vector(3);
-    term_2_vector.zeros();
-    arma::Col<double> particle_diff_vector_1(3);  // r_k - r_j.
-
-    for (particle = 0; particle < current_particle; particle++)
-    {
-        particle_distance_1 =
-            arma::norm((pos.col(current_particle) - pos.col(particle)), 2);
-
-        particle_diff_vector_1 =
-            (pos.col(current_particle) - pos.col(particle))/particle_distance_1;
-
-        if (particle_distance_1 > a)
-        {   /*
-            Interaction if the particle spacing is greater than 'a'.
-            */
-            particle_diff_vector_1 *=
-                a/(1 - a/particle_distance_1)*1/(particle_distance_1*particle_distance_1);
-        }
-        else
-        {
-            particle_diff_vector_1 = {0, 0, 0};
-            // Maybe break here?
-        }
-
-        term_2_vector += particle_diff_vector_1;
-    }
-
-    for (particle = current_particle + 1; particle < n_particles; particle++)
-    {
-        particle_distance_1 =
-            arma::norm((pos.col(current_particle) - pos.col(particle)), 2);
-
-        particle_diff_vector_1 =
-            (pos.col(current_particle) - pos.col(particle))/particle_distance_1;
-
-        if (particle_distance_1 > a)
-        {   /*
-            Interaction if the particle spacing is greater than 'a'.
-            */
-            particle_diff_vector_1 *=
-                a/(1 - a/particle_distance_1)*1/(particle_distance_1*particle_distance_1);
-        }
-        else
-        {
-            particle_diff_vector_1 = {0, 0, 0};
-            // Maybe break here?
-        }
-
-        term_2_vector += particle_diff_vector_1;
-    }
-
-    particle_diff_vector_1 = {x, y, beta*z};  // Reuse the vector, dont need to allocate a new one.
-    term_2 *= arma::dot(term_2_vector, particle_diff_vector_1);
+    double term_2 = -2*2*alpha*(x*gradient_x + y*gradient_y + beta*z*gradient_z);
     // Term 2 end.
 
-    // Term 3.
-    double term_3 = 0;
-    double particle_distance_2;
-    double u_diff_1;
-    double u_diff_2;
-    arma::Col<double> particle_diff_vector_2(3);
-    
-    for (particle = 0; particle < current_particle; particle++)
-    {
-        particle_diff_vector_1 =
-            pos.col(current_particle) - pos.col(particle);
-        particle_distance_1 =
-            arma::norm((pos.col(current_particle) - pos.col(particle)), 2);
-
-
-        if (particle_distance_1 > a)
-        {   /*
-            Interaction if the particle spacing is greater than 'a'.
-            */
-            u_diff_1 =
-                a/(1 - a/particle_distance_1)*1/(particle_distance_1*particle_distance_1);
-        }
-        else
-        {
-            u_diff_1 = 0;
-        }
-        
-        for (particle_inner = 0; particle_inner < current_particle; particle_inner++)
-        {
-            particle_diff_vector_2 =
-                pos.col(current_particle) - pos.col(particle_inner);
-            particle_distance_2 =
-                arma::norm((pos.col(current_particle) - pos.col(particle_inner)), 2);
-
-            if (particle_distance_2 > a)
-            {   /*
-                Interaction if the particle spacing is greater than 'a'.
-                */
-                u_diff_2 =
-                    a/(1 - a/particle_distance_2)*1/(particle_distance_2*particle_distance_2);
-            }
-            else
-            {
-                u_diff_2 = 0;
-            }
-
-            term_3 += arma::dot(
-                particle_diff_vector_1,
-                particle_diff_vector_2
-            )/(particle_distance_1*particle_distance_2)*u_diff_1*u_diff_2;
-        }
-
-        for (particle_inner = current_particle + 1; particle_inner < n_particles; particle_inner++)
-        {
-            particle_diff_vector_2 =
-                pos.col(current_particle) - pos.col(particle_inner);
-            particle_distance_2 =
-                arma::norm((pos.col(current_particle) - pos.col(particle_inner)), 2);
-
-            if (particle_distance_2 > a)
-            {   /*
-                Interaction if the particle spacing is greater than 'a'.
-                */
-                u_diff_2 =
-                    a/(1 - a/particle_distance_2)*1/(particle_distance_2*particle_distance_2);
-            }
-            else
-            {
-                u_diff_2 = 0;
-            }
-
-            term_3 += arma::dot(
-                particle_diff_vector_1,
-                particle_diff_vector_2
-            )/(particle_distance_1*particle_distance_2)*u_diff_1*u_diff_2;
-        }
-    }
-
-    for (particle = current_particle + 1; particle < n_particles; particle++)
-    {
-        particle_diff_vector_1 =
-            pos.col(current_particle) - pos.col(particle);
-        particle_distance_1 =
-            arma::norm((pos.col(current_particle) - pos.col(particle)), 2);
-
-
-        if (particle_distance_1 > a)
-        {   /*
-            Interaction if the particle spacing is greater than 'a'.
-            */
-            u_diff_1 =
-                a/(1 - a/particle_distance_1)*1/(particle_distance_1*particle_distance_1);
-        }
-        else
-        {
-            u_diff_1 = 0;
-        }
-        
-        for (particle_inner = 0; particle_inner < current_particle; particle_inner++)
-        {
-            particle_diff_vector_2 =
-                pos.col(current_particle) - pos.col(particle_inner);
-            particle_distance_2 =
-                arma::norm((pos.col(current_particle) - pos.col(particle_inner)), 2);
-
-            if (particle_distance_2 > a)
-            {   /*
-                Interaction if the particle spacing is greater than 'a'.
-                */
-                u_diff_2 =
-                    a/(1 - a/particle_distance_2)*1/(particle_distance_2*particle_distance_2);
-            }
-            else
-            {
-                u_diff_2 = 0;
-            }
-
-            term_3 += arma::dot(
-                particle_diff_vector_1,
-                particle_diff_vector_2
-            )/(particle_distance_1*particle_distance_2)*u_diff_1*u_diff_2;
-        }
-
-        for (particle_inner = current_particle + 1; particle_inner < n_particles; particle_inner++)
-        {
-            particle_diff_vector_2 =
-                pos.col(current_particle) - pos.col(particle_inner);
-            particle_distance_2 =
-                arma::norm((pos.col(current_particle) - pos.col(particle_inner)), 2);
-
-            if (particle_distance_2 > a)
-            {   /*
-                Interaction if the particle spacing is greater than 'a'.
-                */
-                u_diff_2 =
-                    a/(1 - a/particle_distance_2)*1/(particle_distance_2*particle_distance_2);
-            }
-            else
-            {
-                u_diff_2 = 0;
-            }
-
-            term_3 += arma::dot(
-                particle_diff_vector_1,
-                particle_diff_vector_2
-            )/(particle_distance_1*particle_distance_2)*u_diff_1*u_diff_2;
-        }
-    }
+    // Term 3. The double sum over pairs (k, j), (k, i) is the squared
+    // norm of the Jastrow gradient.
+    double term_3 = gradient_x*gradient_x + gradient_y*gradient_y + gradient_z*gradient_z;
     // Term 3 end.
 
-    // Term 4.
-    double term_4 = 0;
-    for (particle = 0; particle < current_particle; particle++)
-    {   
-        particle_distance_1 =
-            arma::norm((pos.col(current_particle) - pos.col(particle)), 2);
-
-        if (particle_distance_1 > a)
-        {   /*
-            Interaction if the particle spacing is greater than 'a'.
-            */
-            u_diff_1 =
-                a/(1 - a/particle_distance_1)*1/(particle_distance_1*particle_distance_1);
-            u_diff_1 *= 2/particle_distance_1;
-
-            u_diff_2 = (a*a - 2*a*particle_distance_1)/(particle_distance_1*particle_distance_1*(particle_distance_1 - a)*(particle_distance_1 - a));
-        }
-        else
-        {
-            u_diff_1 = 0;
-            u_diff_2 = 0;
-        }
-
-        term_4 += u_diff_1 + u_diff_2;
-    }
-    // Term 4 end.
-
-    // double res = -hbar*hbar/(2*m)*(term_1 + term_2 + term_3 + term_4);
-    double res = 0.5*(-(term_1 + term_2 + term_3 + term_4) + x*x + y*y + z*z*gamma_*gamma_);
-    // res += 0.5*m*(omega*omega*(x*x + y*y) + omega_z*omega_z*z*z);   // V_ext.
+    double res = -hbar*hbar/(2*m)*(term_1 + term_2 + term_3 + term_4);
+    res += 0.5*m*((x*x + y*y)*omega*omega + z*z*omega_z*omega_z);  // V_ext.
 
     return res;
 }
 
-double local_energy_3d_no_interaction(
+double local_energy_3d_interaction_total(
     const arma::Mat<double> &pos,
+    const DistanceCache &distances,
     const double alpha,
     const double beta,
-    const int current_particle,
     const int n_particles
 )
 {   /*
-    Calculate the local energy for a single particle. Analytical
-    expression for the local energy for 3 dimensions, no interaction
-    between particles.
+    Analytical expression for the total local energy of all particles
+    for 3 dimensions, with interaction between particles.  The sum of
+    local_energy_3d_interaction over all particles, each of which reads
+    its column of the distance cache and the structure-of-arrays
+    positions in a vectorized loop.  O(N^2), and allocates nothing.
 
     Parameters
     ----------
     pos : arma::Mat<double> reference
-        Positions of all particles.
-
-    alpha : constant double
-        Current variational parameter.
-
-    beta : constant double
-        ???
-
-    current_particle : constant integer
-        The index of the current particle.
-
-    n_particles : constant integer
-        The total number of particles.
-    */
-    const double x = pos(0, current_particle);
-    const double y = pos(1, current_particle);
-    const double z = pos(2, current_particle);
-
-    return -hbar*hbar*alpha/m*(2*alpha*(x*x + y*y + beta*beta*z*z) - 2 - beta) + 0.5*m*omega*omega*(x*x + y*y + z*z);
-}
-
-double local_energy_2d_no_interaction(
-    const arma::Mat<double> &pos,
-    const double alpha,
-    const double beta,
-    const int current_particle,
-    const int n_particles
-)
-{   /*
-    Analytical expression for the local energy for 2 dimensions, no
-    interaction between particles.
+        Reference to position matrix of all particles. 3xN.
 
-    Parameters
-    ----------
-    pos : arma::Mat<double> reference
-        Positions of all particles.
+    distances : DistanceCache reference
+        Pairwise distances of all particles in 'pos'.
 
-    alpha : constant double
-        Current variational parameter.
+    alpha : double
+        Variational parameter.
 
-    beta : constant double
+    beta : double
         ???
 
-    current_particle : constant integer
-        The index of the current particle.
-
     n_particles : constant integer
         The total number of particles.
     */
-    double x = pos(0, current_particle);
-    double y = pos(1, current_particle);
-    return -hbar*hbar*alpha/m*(2*alpha*(x*x + y*y) - 2) +
-        0.5*m*omega*omega*(x*x + y*y);
-}
-
-double local_energy_1d_no_interaction(
-    const arma::Mat<double> &pos,
-    const double alpha,
-    const double beta,
-    const int current_particle,
-    const int n_particles
-)
-{   /*
-    Analytical expression for the local energy for 1 dimensions, no
-    interaction between particles.
-
-    Parameters
-    ----------
-    pos : arma::Mat<double> reference
-        Positions of all particles.
-
-    alpha : constant double
-        Current variational parameter.
-
-    beta : constant double
-        ???
-
-    current_particle : constant integer
-        The index of the current particle.
+    double res = 0;
+    for (int particle = 0; particle < n_particles; particle++)
+    {
+        res += local_energy_3d_interaction(pos, distances, alpha, beta, particle, n_particles);
+    }
 
-    n_particles : constant integer
-        The total number of particles.
-    */
-    double x = pos(0, current_particle);
-    return -hbar*hbar*alpha/m*(2*alpha*x*x - 1) + 0.5*m*omega*omega*x*x;
+    return res;
 }
 
 double local_energy_1d_no_interaction_numerical_differentiation(
     const arma::Mat<double> &pos,
+    const DistanceCache &distances,
     const double alpha,
     const double beta,
     const int current_particle,
@@ -510,6 +255,9 @@ double local_energy_1d_no_interaction_numerical_differentiation(
     pos : arma::Mat<double> reference
         Positions of all particles.
 
+    distances : DistanceCache reference
+        Pairwise distances. Not in use without interaction.
+
     alpha : constant double
         Current variational parameter.
 
@@ -542,6 +290,7 @@ double local_energy_1d_no_interaction_numerical_differentiation(
 
 double local_energy_2d_no_interaction_numerical_differentiation(
     const arma::Mat<double> &pos,
+    const DistanceCache &distances,
     const double alpha,
     const double beta,
     const int current_particle,
@@ -556,6 +305,9 @@ double local_energy_2d_no_interaction_numerical_differentiation(
     pos : arma::Mat<double> reference
         Positions of all particles.
 
+    distances : DistanceCache reference
+        Pairwise distances. Not in use without interaction.
+
     alpha : constant double
         Current variational parameter.
 
@@ -596,6 +348,7 @@ double local_energy_2d_no_interaction_numerical_differentiation(
 
 double local_energy_3d_no_interaction_numerical_differentiation(
     const arma::Mat<double> &pos,
+    const DistanceCache &distances,
     const double alpha,
     const double beta,
     const int current_particle,
@@ -610,6 +363,9 @@ double local_energy_3d_no_interaction_numerical_differentiation(
     pos : arma::Mat<double> reference
         Positions of all particles.
 
+    distances : DistanceCache reference
+        Pairwise distances. Not in use without interaction.
+
     alpha : constant double
         Current variational parameter.
 
@@ -652,5 +408,5 @@ double local_energy_3d_no_interaction_numerical_differentiation(
         autodiff::forward::at(x_autodiff, y_autodiff, z_autodiff, params)
     );
     return -hbar*(double(uxx) + double(uyy) + double(uzz))/(2*m*double(u.val)) +
-        0.5*m*omega*omega*(x*x + y*y + z*z);
-}
\ No newline at end of file
+        0.5*m*((x*x + y*y)*omega*omega + z*z*omega_z*omega_z);
+}
@@ -1,9 +1,11 @@
 #ifndef OTHER
 #define OTHER
 #include "VMC.h"
+#include "parameters.h"
 
 double local_energy_3d_interaction_vala(
     const arma::Mat<double> &pos,
+    const DistanceCache &distances,
     const double alpha,
     const double beta,
     const int current_particle,
@@ -11,51 +13,95 @@ double local_energy_3d_interaction_vala(
 );
 double local_energy_3d_interaction(
     const arma::Mat<double> &pos,
+    const DistanceCache &distances,
     const double alpha,
     const double beta,
     const int current_particle,
     const int n_particles
 );
-double local_energy_3d_no_interaction(
+double local_energy_3d_interaction_total(
     const arma::Mat<double> &pos,
+    const DistanceCache &distances,
     const double alpha,
     const double beta,
-    const int current_particle,
     const int n_particles
 );
-double local_energy_2d_no_interaction(
-    const arma::Mat<double> &pos,
-    const double alpha,
-    const double beta,
-    const int current_particle,
-    const int n_particles
-);
-double local_energy_1d_no_interaction(
+double local_energy_1d_no_interaction_numerical_differentiation(
     const arma::Mat<double> &pos,
+    const DistanceCache &distances,
     const double alpha,
     const double beta,
     const int current_particle,
     const int n_particles
 );
-double local_energy_1d_no_interaction_numerical_differentiation(
+double local_energy_2d_no_interaction_numerical_differentiation(
     const arma::Mat<double> &pos,
+    const DistanceCache &distances,
     const double alpha,
     const double beta,
     const int current_particle,
     const int n_particles
 );
-double local_energy_2d_no_interaction_numerical_differentiation(
+double local_energy_3d_no_interaction_numerical_differentiation(
     const arma::Mat<double> &pos,
+    const DistanceCache &distances,
     const double alpha,
     const double beta,
     const int current_particle,
     const int n_particles
 );
-double local_energy_3d_no_interaction_numerical_differentiation(
+template <int n_dims>
+inline double local_energy_no_interaction(
     const arma::Mat<double> &pos,
+    const DistanceCache &distances,
     const double alpha,
     const double beta,
     const int current_particle,
     const int n_particles
-);
+)
+{   /*
+    Calculate the local energy for a single particle. Analytical
+    expression for the local energy in 'n_dims' dimensions, no
+    interaction between particles.  The one-body factor
+    exp(-alpha(x^2 + y^2 + beta z^2)) gives the kinetic term
+    -hbar^2 alpha/m (2 alpha sum_d c_d^2 r_d^2 - sum_d c_d), where c_d
+    is 1 for x and y and beta for z.
+
+    Parameters
+    ----------
+    pos : arma::Mat<double> reference
+        Positions of all particles.
+
+    distances : DistanceCache reference
+        Pairwise distances. Not in use without interaction.
+
+    alpha : constant double
+        Current variational parameter.
+
+    beta : constant double
+        ???
+
+    current_particle : constant integer
+        The index of the current particle.
+
+    n_particles : constant integer
+        The total number of particles.
+    */
+    const double *r = pos.colptr(current_particle);
+    double weighted_r_squared = 0;  // sum_d c_d^2 r_d^2.
+    double weight_sum = 0;          // sum_d c_d.
+    double potential = 0;           // sum_d omega_d^2 r_d^2.
+
+    for (int dim = 0; dim < n_dims; dim++)
+    {
+        const double c = (dim == 2) ? beta : 1;
+        const double omega_d = (dim == 2) ? omega_z : omega;
+        weighted_r_squared += c*c*r[dim]*r[dim];
+        weight_sum += c;
+        potential += r[dim]*r[dim]*omega_d*omega_d;
+    }
+
+    return -hbar*hbar*alpha/m*(2*alpha*weighted_r_squared - weight_sum) +
+        0.5*m*potential;
+}
 #endif
\ No newline at end of file
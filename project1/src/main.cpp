@@ -1,6 +1,9 @@
 #include "VMC.h"
 #include "methods.h"
 #include "parameters.h"
+#include "config.h"
+#include "sweep.h"
+#include "distributed.h"
 
 void print_parameters(
     bool parallel,
@@ -44,6 +47,8 @@ void print_parameters(
     std::cout << "gd_tolerance: " << gd_tolerance << std::endl;
     std::cout << "brute_force_step_size: " << brute_force_step_size << std::endl;
     std::cout << "a: " << a << std::endl;
+    std::cout << "omega: " << omega << std::endl;
+    std::cout << "gamma: " << gamma_ << std::endl;
     std::cout << "--------------------------" << std::endl;
     std::cout << std::endl;
 }
@@ -90,65 +95,174 @@ void generate_filenames(
     fname_energies = fname_particles;
     fname_energies += "energies_";
     fname_energies += std::to_string(a);
-    fname_energies += "_.txt";
+    fname_energies += "_.bin";
 
     fname_particles += "particles_";
     fname_particles += std::to_string(a);
     fname_particles += "_.txt";
 }
 
+std::unique_ptr<EnergySink> create_energy_sink(
+    const std::string energy_output,
+    std::string fname_energies,
+    const int energy_decimation
+)
+{   /*
+    Create the sink for the local energy of every MC cycle.
+
+    Parameters
+    ----------
+    energy_output : constant std::string
+        "none" keeps only the blocking analysis. "memory" keeps all
+        energies and writes them as text at the end. "file" streams them
+        to a binary file. "decimated" streams every
+        'energy_decimation'-th energy to a binary file.
+
+    fname_energies : std::string
+        Binary energy file name. ".bin" is replaced by ".txt" for
+        "memory".
+
+    energy_decimation : constant integer
+        Stride for "decimated".
+    */
+    if (distributed_size() > 1)
+    {   /*
+        Every rank writes the energies of its own walkers.
+        */
+        fname_energies.insert(fname_energies.size() - 4, "rank" + std::to_string(distributed_rank()));
+    }
+
+    if (energy_output == "none")
+    {
+        return nullptr;
+    }
+    else if (energy_output == "memory")
+    {
+        fname_energies.replace(fname_energies.size() - 4, 4, ".txt");
+        return std::make_unique<MemorySink>(fname_energies);
+    }
+    else if (energy_output == "file")
+    {
+        return std::make_unique<FileSink>(fname_energies, false);
+    }
+    else if (energy_output == "decimated")
+    {
+        return std::make_unique<DecimatedSink>(
+            std::make_unique<FileSink>(fname_energies, false),
+            energy_decimation
+        );
+    }
+    std::cout << "Unknown energy output '" << energy_output << "'! Exiting..." << std::endl;
+    exit(0);
+}
+
 int main(int argc, char *argv[])
 {   /*
+    Run parameters are read from the command line, "--key value" or
+    "--key=value", and from an optional config file given by
+    "--config <file>", see vmc.cfg for all keys and their defaults.
+    Command line values override the config file.  "--restart <file>"
+    resumes from a checkpoint.  Built with 'make mpi', the walkers are
+    divided between the ranks, and only rank 0 prints and writes the
+    results, see distributed.h.
 
     const double importance_time_step = 0.04; funker best med mange
     partikler.
 
     litt over 0.28
     */
+    distributed_init(argc, argv);
+    const bool root = distributed_root();
+
+    Config config;
+    config.read_arguments(argc, argv);
+
     // Parameter definitions.
     bool parallel;
     double beta;
 
     // Global parameters:
-    double brute_force_step_size      = 0.2;
-    const double importance_time_step = 0.1;
-    const double initial_alpha_gd     = 0.2;                // Initial variational parameter. Only for GD.
-    const double learning_rate        = 1e-4;               // GD learning rate.
-    const int n_gd_iterations         = 200;                // Max. gradient descent iterations.
-    long seed                         = time(NULL);
-    const double gd_tolerance         = 1e-4;
-    const bool debug                  = true;               // Toggle debug print on / off.
-
-    const bool interaction               = false;
-    const bool numerical_differentiation = false;
-    const int n_variations               = 1;               // Number of variational parameters. Not in use with GD.
-    const int n_mc_cycles                = std::pow(2, 20); // Number of MC cycles, must be a power of 2
-    const int n_dims                     = 3;               // Number of dimensions.
-    const int n_particles                = 10;              // Number of particles.
-    arma::Col<double> alphas             = arma::linspace(0.5, 0.5, n_variations);
-
-    // Select methods (choose one at a time):
-    const bool gradient_descent    = false;
-    const bool importance_sampling = true;
-    const bool brute_force         = false;
+    double brute_force_step_size      = config.get_double("brute_force_step_size", 0.2);
+    const double importance_time_step = config.get_double("importance_time_step", 0.1);
+    const double initial_alpha_gd     = config.get_double("initial_alpha_gd", 0.2);     // Initial variational parameter. Only for GD.
+    const double learning_rate        = config.get_double("learning_rate", 1e-4);       // GD learning rate.
+    const std::string optimizer       = config.get_string("optimizer", "gradient");     // "gradient", "adam" or "sr".
+    const bool optimize_beta          = config.get_bool("optimize_beta", false);        // Optimize beta together with alpha.
+    const double adam_learning_rate   = config.get_double("adam_learning_rate", 0.01);  // Approx. step of alpha with Adam.
+    const double sr_learning_rate     = config.get_double("sr_learning_rate", 0.5);     // Fraction of the SR step.
+    const double sr_regularization    = config.get_double("sr_regularization", 1e-3);   // Relative diagonal shift of S.
+    const std::string objective       = config.get_string("objective", "energy");       // "energy" or "variance".
+    const bool line_search            = config.get_bool("line_search", false);          // Adaptive scaling of the optimizer step.
+    const int n_gd_iterations         = config.get_int("n_gd_iterations", 200);         // Max. gradient descent iterations.
+    long seed                         = config.get_long("seed", time(NULL));
+    const double gd_tolerance         = config.get_double("gd_tolerance", 1e-4);
+    const int gd_min_cycles           = config.get_int("gd_min_cycles", 0);             // Cycles of the first GD iteration, growing to n_mc_cycles. 0 for off.
+    const bool debug                  = config.get_bool("debug", true) and root;        // Toggle debug print on / off.
+    const std::string energy_output   = config.get_string("energy_output", "none");     // "none", "memory", "file" or "decimated". Blocking errors are in the particles file.
+    const int energy_decimation       = config.get_int("energy_decimation", 64);        // Keep every n-th energy with "decimated".
+    const double checkpoint_interval  = config.get_double("checkpoint_interval", 600);   // Min. seconds between checkpoints.
+    const std::string restart_fpath   = config.get_string("restart", "");               // Checkpoint to resume.
+    const int n_walkers               = config.get_int("n_walkers", 0);                 // Total number of walkers. 0 for one per thread.
+    const int n_burn_in_cycles        = config.get_int("n_burn_in_cycles", 1000);       // Discarded MC cycles per walker.
+    const int burn_in_window          = config.get_int("burn_in_window", 0);            // Automatic burn-in after n_burn_in_cycles. 0 for off.
+    const int max_burn_in_cycles      = config.get_int("max_burn_in_cycles", 100000);   // Max. burn-in cycles per walker with automatic burn-in.
+
+    const bool interaction               = config.get_bool("interaction", false);
+    const bool numerical_differentiation = config.get_bool("numerical_differentiation", false);
+    const int n_variations               = config.get_int("n_variations", 1);           // Number of variational parameters. Not in use with GD.
+    const int n_mc_cycles                = config.get_int("n_mc_cycles", std::pow(2, 20)); // Number of MC cycles, must be a power of 2
+    const double target_error            = config.get_double("target_error", 0);        // Run chunks of n_mc_cycles until the energy error is below this. 0 for off.
+    const long max_cycles                = config.get_long("max_cycles", std::pow(2, 26)); // Max. MC cycles per variation with a target error.
+    const double min_ess_fraction        = config.get_double("min_ess_fraction", 0);    // Reweight the alpha scan from one chain down to this sample size fraction. 0 for off.
+    const int n_dims                     = config.get_int("n_dims", 3);                 // Number of dimensions.
+    const int n_particles                = config.get_int("n_particles", 10);           // Number of particles.
+    const double alpha_start             = config.get_double("alpha_start", 0.5);
+    const double alpha_end               = config.get_double("alpha_end", alpha_start);
+    arma::Col<double> alphas             = arma::linspace(alpha_start, alpha_end, n_variations);
+
+    // Trap and interaction parameters, see parameters.h. The trap is
+    // spherical by default without interaction.
+    set_parameters(
+        config.get_double("omega", omega),
+        config.get_double("a", a),
+        config.get_double("gamma", interaction ? gamma_ : 1)
+    );
+
+    // Select method: "importance", "brute" or "gradient".
+    const std::string method       = config.get_string("method", "importance");
+    const bool gradient_descent    = method == "gradient";
+    const bool importance_sampling = method == "importance";
+    const bool brute_force         = method == "brute";
 
     if (interaction)
     {
-        beta = 2.82843;
+        beta = config.get_double("beta", gamma_);
     }
     else
     {
-        beta = 1;
+        beta = config.get_double("beta", 1);
     }
 
-    if ((gradient_descent and importance_sampling) or (gradient_descent and brute_force) or (importance_sampling and brute_force))
+    // Parameter sweep: every combination of the lists below is run as an
+    // independent brute force or importance calculation, see sweep.h.
+    const bool sweep                 = config.get_bool("sweep", false);
+    const std::vector<double> sweep_n_particles = config.get_list("sweep_n_particles", {double(n_particles)});
+    const std::vector<double> sweep_alphas = config.get_list("sweep_alphas", std::vector<double>(alphas.memptr(), alphas.memptr() + alphas.n_elem));
+    const std::vector<double> sweep_betas  = config.get_list("sweep_betas", {beta});
+    const std::vector<double> sweep_steps  = config.get_list("sweep_steps",
+        {brute_force ? brute_force_step_size : importance_time_step});
+    config.check_unused();
+    distributed_broadcast(seed);    // The default seed may differ between the ranks.
+
+    if (!gradient_descent and !brute_force and !importance_sampling)
     {
-        std::cout << "Please choose only one method at a time! Exiting..." << std::endl;
+        std::cout << "Unknown method '" << method << "'. Exiting..." << std::endl;
         exit(0);
     }
-    if (!gradient_descent and !brute_force and !importance_sampling)
-    {
-        std::cout << "No method is chosen. Exiting..." << std::endl;
+
+    if (gradient_descent and (min_ess_fraction != 0))
+    {   // Reweighting only applies to the alpha scan of "importance" and "brute".
+        std::cout << "min_ess_fraction is not in use with method 'gradient'. Exiting..." << std::endl;
         exit(0);
     }
 
@@ -158,7 +272,7 @@ int main(int argc, char *argv[])
         parallel = false;
     #endif
 
-    print_parameters(
+    if (root) print_parameters(
         parallel,
         interaction,
         n_dims,
@@ -189,10 +303,57 @@ int main(int argc, char *argv[])
         t1 = std::chrono::steady_clock::now();
     #endif
 
+    // Sweep -----------------------------------------------------------
+    if (sweep)
+    {
+        if (root) std::cout << "Parameter sweep" << std::endl;
+
+        Sweep sweep_1(method, n_dims, n_mc_cycles, interaction, numerical_differentiation);
+        sweep_1.n_walkers = (n_walkers > 0) ? n_walkers : 1;
+        sweep_1.n_burn_in_cycles = n_burn_in_cycles;
+        sweep_1.burn_in_window = burn_in_window;
+        sweep_1.max_burn_in_cycles = max_burn_in_cycles;
+        sweep_1.target_error = target_error;
+        sweep_1.max_cycles = max_cycles;
+
+        for (const double n : sweep_n_particles)
+        {
+            for (const double alpha : sweep_alphas)
+            {
+                for (const double beta_ : sweep_betas)
+                {
+                    for (const double step : sweep_steps)
+                    {
+                        sweep_1.add_point(std::lround(n), alpha, beta_, step);
+                    }
+                }
+            }
+        }
+        sweep_1.run(seed);
+
+        #ifdef _OPENMP
+            t2 = omp_get_wtime();
+            comp_time = t2 - t1;
+            if (root) std::cout << "total time: " << comp_time << "s\n" << std::endl;
+        #else
+            t2 = std::chrono::steady_clock::now();
+            comp_time = std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1);
+            if (root) std::cout << "total time: " << comp_time.count() << "s\n" << std::endl;
+        #endif
+
+        std::string fname_sweep = "generated_data/sweep_" + method;
+        fname_sweep += "_interaction_" + std::to_string(interaction);
+        fname_sweep += "_dims_" + std::to_string(n_dims);
+        fname_sweep += "_mc_" + std::to_string(n_mc_cycles) + ".txt";
+        if (root) sweep_1.write_to_file(fname_sweep);
+        distributed_finalize();
+        return 0;
+    }
+
     // Importance ------------------------------------------------------
     if (importance_sampling)
     {
-        std::cout << "Importance sampling" << std::endl;
+        if (root) std::cout << "Importance sampling" << std::endl;
 
         std::string fname_importance_particles;
         std::string fname_importance_onebody;
@@ -226,20 +387,37 @@ int main(int argc, char *argv[])
         system_1.set_quantum_force(interaction);
         system_1.set_local_energy(interaction);
         system_1.set_seed(seed);
+        system_1.set_verbose(root);
+        if (n_walkers > 0) system_1.set_n_walkers(n_walkers);
+        system_1.set_burn_in(n_burn_in_cycles);
+        system_1.set_auto_burn_in(burn_in_window, max_burn_in_cycles);
+        system_1.set_target_error(target_error, max_cycles);
+        system_1.set_reweighting(min_ess_fraction);
+        std::unique_ptr<EnergySink> energy_sink = create_energy_sink(
+            energy_output,
+            fname_importance_energies,
+            energy_decimation
+        );
+        system_1.set_energy_sink(energy_sink.get());
+        system_1.set_checkpoint("generated_data/checkpoint_importance.bin", checkpoint_interval);
+        if (!restart_fpath.empty()) system_1.restart(restart_fpath);
         system_1.solve();
 
         #ifdef _OPENMP
             t2 = omp_get_wtime();
             comp_time = t2 - t1;
-            std::cout << "total time: " << comp_time << "s\n" << std::endl;
+            if (root) std::cout << "total time: " << comp_time << "s\n" << std::endl;
         #else
             t2 = std::chrono::steady_clock::now();
             comp_time = std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1);
-            std::cout << "total time: " << comp_time.count() << "s\n" << std::endl;
+            if (root) std::cout << "total time: " << comp_time.count() << "s\n" << std::endl;
         #endif
-        system_1.write_to_file(fname_importance_particles);
-        system_1.write_energies_to_file(fname_importance_energies);
-        system_1.write_to_file_onebody_density(fname_importance_onebody);
+        if (energy_sink) energy_sink->finish();
+        if (root)
+        {
+            system_1.write_to_file(fname_importance_particles);
+            system_1.write_to_file_onebody_density(fname_importance_onebody);
+        }
     }
 
     // Brute -----------------------------------------------------------
@@ -251,7 +429,7 @@ int main(int argc, char *argv[])
             t1 = std::chrono::steady_clock::now();
         #endif
 
-        std::cout << "Brute force metropolis" << std::endl;
+        if (root) std::cout << "Brute force metropolis" << std::endl;
 
         std::string fname_brute_particles;
         std::string fname_brute_onebody;
@@ -285,20 +463,37 @@ int main(int argc, char *argv[])
         system_2.set_quantum_force(interaction);
         system_2.set_local_energy(interaction);
         system_2.set_seed(seed);
+        system_2.set_verbose(root);
+        if (n_walkers > 0) system_2.set_n_walkers(n_walkers);
+        system_2.set_burn_in(n_burn_in_cycles);
+        system_2.set_auto_burn_in(burn_in_window, max_burn_in_cycles);
+        system_2.set_target_error(target_error, max_cycles);
+        system_2.set_reweighting(min_ess_fraction);
+        std::unique_ptr<EnergySink> energy_sink = create_energy_sink(
+            energy_output,
+            fname_brute_energies,
+            energy_decimation
+        );
+        system_2.set_energy_sink(energy_sink.get());
+        system_2.set_checkpoint("generated_data/checkpoint_brute.bin", checkpoint_interval);
+        if (!restart_fpath.empty()) system_2.restart(restart_fpath);
         system_2.solve();
 
         #ifdef _OPENMP
             t2 = omp_get_wtime();
             comp_time = t2 - t1;
-            std::cout << "total time: " << comp_time << "s\n" << std::endl;
+            if (root) std::cout << "total time: " << comp_time << "s\n" << std::endl;
         #else
             t2 = std::chrono::steady_clock::now();
             comp_time = std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1);
-            std::cout << "total time: " << comp_time.count() << "s\n" << std::endl;
+            if (root) std::cout << "total time: " << comp_time.count() << "s\n" << std::endl;
         #endif
-        system_2.write_to_file(fname_brute_particles);
-        system_2.write_energies_to_file(fname_brute_energies);
-        system_2.write_to_file_onebody_density(fname_brute_onebody);
+        if (energy_sink) energy_sink->finish();
+        if (root)
+        {
+            system_2.write_to_file(fname_brute_particles);
+            system_2.write_to_file_onebody_density(fname_brute_onebody);
+        }
     }
 
     // GD --------------------------------------------------------------
@@ -310,7 +505,7 @@ int main(int argc, char *argv[])
             t1 = std::chrono::steady_clock::now();
         #endif
 
-        std::cout << "Gradient decent" << std::endl;
+        if (root) std::cout << "Gradient decent" << std::endl;
 
         std::string fname_gradient_particles;
         std::string fname_gradient_onebody;
@@ -345,24 +540,60 @@ int main(int argc, char *argv[])
         system_3.set_quantum_force(interaction);
         system_3.set_local_energy(interaction);
         system_3.set_seed(seed);
+        system_3.set_verbose(root);
+        if (n_walkers > 0) system_3.set_n_walkers(n_walkers);
+        system_3.set_burn_in(n_burn_in_cycles);
+        system_3.set_auto_burn_in(burn_in_window, max_burn_in_cycles);
+        system_3.set_target_error(target_error, max_cycles);
+        std::unique_ptr<EnergySink> energy_sink = create_energy_sink(
+            energy_output,
+            fname_gradient_energies,
+            energy_decimation
+        );
+        system_3.set_energy_sink(energy_sink.get());
+        system_3.set_optimize_beta(optimize_beta);
+        system_3.set_objective(objective);
+        system_3.set_line_search(line_search);
+        system_3.set_sample_schedule(gd_min_cycles);
+        if (optimizer == "adam")
+        {
+            system_3.set_optimizer(std::make_unique<Adam>(1 + optimize_beta, adam_learning_rate));
+        }
+        else if (optimizer == "sr")
+        {
+            system_3.set_optimizer(std::make_unique<StochasticReconfiguration>(
+                sr_learning_rate,
+                sr_regularization
+            ));
+        }
+        else if (optimizer != "gradient")
+        {
+            std::cout << "Unknown optimizer '" << optimizer << "'. Exiting..." << std::endl;
+            exit(0);
+        }
+        system_3.set_checkpoint("generated_data/checkpoint_gradient.bin", checkpoint_interval);
+        if (!restart_fpath.empty()) system_3.restart(restart_fpath);
         system_3.solve(gd_tolerance);
 
         #ifdef _OPENMP
             t2 = omp_get_wtime();
             comp_time = t2 - t1;
-            std::cout << "total time: " << comp_time << "s\n" << std::endl;
+            if (root) std::cout << "total time: " << comp_time << "s\n" << std::endl;
         #else
             t2 = std::chrono::steady_clock::now();
             comp_time = std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1);
-            std::cout << "total time: " << comp_time.count() << "s\n" << std::endl;
+            if (root) std::cout << "total time: " << comp_time.count() << "s\n" << std::endl;
         #endif
 
-        system_3.write_to_file(fname_gradient_particles);
-        system_3.write_energies_to_file(fname_gradient_energies);
-        system_3.write_to_file_onebody_density(fname_gradient_onebody);
+        if (energy_sink) energy_sink->finish();
+        if (root)
+        {
+            system_3.write_to_file(fname_gradient_particles);
+            system_3.write_to_file_onebody_density(fname_gradient_onebody);
+        }
     }
 
-    print_parameters(
+    if (root) print_parameters(
         parallel,
         interaction,
         n_dims,
@@ -382,5 +613,6 @@ int main(int argc, char *argv[])
         numerical_differentiation
     );
 
+    distributed_finalize();
     return 0;
 }
@@ -1,4 +1,7 @@
 #include "methods.h"
+#include "sampler.h"
+#include "distributed.h"
+#include "checkpoint.h"
 
 BruteForce::BruteForce(
     const int n_dims_input,
@@ -47,145 +50,94 @@ BruteForce::BruteForce(
     */
 }
 
-void BruteForce::one_variation(int variation)
+void BruteForce::draw_initial_positions(Walker &walker)
 {   /*
-    Perform calculations for a single variational parameter.
+    Draw uniformly distributed initial positions. Positions are redrawn
+    until no particles are closer than 'a'.
 
     Parameters
     ----------
-    variation : int
-        Which iteration of variational parameter alpha.
+    walker : Walker reference
+        The walker to place.
     */
+    for (int particle = 0; particle < n_particles; particle++)
+    {   /*
+        Iterate over all particles.
+        */
+        do
+        {
+            for (int dim = 0; dim < n_dims; dim++)
+            {   /*
+                Set initial values.
+                */
+                walker.pos_current(dim, particle) =
+                    step_size*(walker.random.uniform() - 0.5);
+            }
+        } while (overlaps(walker.pos_current, particle));
+    }
+}
 
-    double alpha = alphas(variation);
-    int acceptance = 0;  // Debug.
+template <int dims, bool interaction_t>
+bool BruteForce::metropolis_step(
+    Walker &walker,
+    const int particle,
+    const double alpha
+)
+{   /*
+    Propose a uniformly distributed move of a single particle and
+    perform the Metropolis test.
+
+    Parameters
+    ----------
+    walker : Walker reference
+        The walker to move.
 
-    energy_expectation = 0; // Reset for each variation.
-    energy_variance = 0;    // Reset for each variation. NB: Variable not inside parallel region.
-    energy_expectation_squared = 0;
+    particle : constant integer
+        Index of the particle to move.
 
-    // One-body density.
-    double particle_distance;
-    particle_per_bin_count_thread.zeros();
-    // One-body density end.
+    alpha : constant double
+        Current variational parameter.
 
-    for (particle = 0; particle < n_particles; particle++)
+    Returns
+    -------
+    : boolean
+        True if the move was accepted.
+    */
+    for (int dim = 0; dim < dims; dim++)
     {   /*
-        Iterate over all particles.  In this loop, all current
-        positions are calulated along with the current wave
-        functions.
+        Set new values.
         */
-        for (dim = 0; dim < n_dims; dim++)
-        {   /*
-            Set initial values.
-            */
-            pos_current(dim, particle) = step_size*(uniform(engine) - 0.5);
-        }
+        walker.pos_new(dim, particle) = walker.pos_current(dim, particle) +
+            step_size*(walker.random.uniform() - 0.5);
     }
-    wave_current = wave_function_ptr(
-        pos_current,  // Position of one particle.
-        alpha,
-        beta,
-        n_particles
-    );
-
-    #pragma omp parallel \
-        private(mc, particle, dim, particle_inner) \
-        private(wave_new) \
-        firstprivate(wave_current, local_energy) \
-        firstprivate(pos_new, pos_current, particle_per_bin_count_thread) \
-        reduction(+:acceptance, energy_expectation, energy_expectation_squared) \
-        private(engine)
-    {
-        #ifdef _OPENMP
-            engine.seed(seed + omp_get_thread_num());
-        #endif
-
-        #pragma omp for
-        for (mc = 0; mc < n_mc_cycles; mc++)
-        {   /*
-            Run over all Monte Carlo cycles.
-            */
-            for (particle = 0; particle < n_particles; particle++)
-            {   /*
-                Iterate over all particles.  In this loop, new
-                proposed positions and wave functions are
-                calculated.
-                */
-                for (dim = 0; dim < n_dims; dim++)
-                {   /*
-                    Set new values.
-                    */
-                    pos_new(dim, particle) = pos_current(dim, particle) + step_size*(uniform(engine) - 0.5);
-                }
+    if constexpr (interaction_t) walker.distances.move(walker.pos_new, particle);
 
-                wave_new = wave_function_ptr(
-                        pos_new,  // Particle positions.
-                        alpha,
-                        beta,
-                        n_particles
-                    );
-
-                double wave_ratio = wave_new/wave_current;
-                wave_ratio *= wave_ratio;
-
-                if (uniform(engine) < wave_ratio)
-                {   /*
-                    Perform the Metropolis algorithm.
-                    */
-
-                    acceptance++;    // Debug.
-                    pos_current.col(particle) = pos_new.col(particle);
-                    wave_current = wave_new;
-
-                    local_energy = 0;   // Overwrite local energy from previous particle step.
-                    for (particle_inner = 0; particle_inner < n_particles; particle_inner++)
-                    {   /*
-                        After moving one particle, the local energy is
-                        calculated based on all particle positions.
-                        */
-                        local_energy += local_energy_ptr(
-                            pos_current,
-                            alpha,
-                            beta,
-                            particle_inner,
-                            n_particles
-                        );
-                    }
-                    // One-body density.
-                    particle_distance = arma::norm(pos_current.col(particle), 2);
-                    for (bin = 0; bin < n_bins - 1; bin++)
-                    {
-                        if (
-                            (particle_distance >= bin_locations(bin)) and
-                            (particle_distance <  bin_locations(bin + 1))
-                        )
-                        {
-                            particle_per_bin_count_thread(bin) += 1;
-                            break;  // No need to continue checking for this particle!
-                        }
-                    }
-                    // One-body density end.
-                }
-                energy_expectation += local_energy;
-                energy_expectation_squared += local_energy*local_energy;
-            }
-            energies(mc, variation) = local_energy;
-        }
-        #pragma omp critical
-        {
-            particle_per_bin_count.col(variation) += particle_per_bin_count_thread;
-        }
-    }   // Parallel end.
+    // |psi_new/psi_current|^2, from the log-ratio. exp(-inf) = 0 if
+    // the proposed position is forbidden.
+    const double log_wave_ratio = wave_function_log_ratio<dims, interaction_t>(walker, particle, alpha);
 
-    energy_expectation /= n_mc_cycles;
-    energy_expectation_squared /= n_mc_cycles;
-    energy_expectation /= n_particles;
-    energy_expectation_squared /= n_particles;
-    energy_variance = energy_expectation_squared
-        - energy_expectation*energy_expectation;
+    if (walker.random.uniform() < std::exp(2*log_wave_ratio))
+    {   /*
+        Perform the Metropolis algorithm.
+        */
+        accept_move<dims, interaction_t>(walker, particle, alpha);
+        return true;
+    }
+    reject_move<interaction_t>(walker, particle);
+    return false;
+}
 
-    acceptances(variation) = acceptance;    // Debug.
+void BruteForce::sample_walker(
+    Walker &walker,
+    const double alpha,
+    const int n_cycles,
+    const bool resume
+)
+{   /*
+    Run a single walker for one variation with the brute force
+    Metropolis step. See VMC::run_walker for parameters.
+    */
+    dispatch_walker(*this, walker, alpha, n_cycles, resume);
 }
 
 ImportanceSampling::ImportanceSampling(
@@ -234,252 +186,134 @@ ImportanceSampling::ImportanceSampling(
     */
 }
 
-void ImportanceSampling::one_variation(int variation)
+void ImportanceSampling::draw_initial_positions(Walker &walker)
 {   /*
-    Perform calculations for a single variational parameter.
+    Draw normally distributed initial positions. Positions are redrawn
+    until no particles are closer than 'a'.
 
     Parameters
     ----------
-    variation : int
-        Which iteration of variational parameter alpha.
+    walker : Walker reference
+        The walker to place.
     */
-
-    double alpha = alphas(variation);
-    int acceptance = 0;  // Debug. Count the number of accepted steps.
-    bool safe_distance = false;
-    pos_current.zeros();
-    // pos_current.print();
-    // pos_new.zeros();
-    qforce_current.zeros();
-    qforce_new.zeros();
-
-    // Reset values for each variation.
-    energy_expectation = 0;
-    energy_variance = 0;
-    energy_expectation_squared = 0;
-
-    // GD specifics.
-    wave_derivative = 0;
-    wave_derivative_expectation = 0;
-    wave_times_energy_expectation = 0;
-    // GD specifics end.
-
-    // One-body density.
-    double particle_distance;
-    particle_per_bin_count_thread.zeros();
-    // One-body density end.
-
-    int not_safe_counter = 0;
-    for (particle = 0; particle < n_particles; particle++)
+    for (int particle = 0; particle < n_particles; particle++)
     {   /*
-        Iterate over all particles.  In this loop, all initial
-        positions are calulated.
+        Iterate over all particles.
         */
-        
-        safe_distance = false;
-        while (!safe_distance)
+        do
         {   /*
             Make sure no particles initially are closer than 'a'.
             */
-            not_safe_counter++;
-            for (dim = 0; dim < n_dims; dim++)
+            for (int dim = 0; dim < n_dims; dim++)
             {   /*
                 Set initial values.
                 */
-                pos_current(dim, particle) = 2*normal(engine)*sqrt(time_step);
-            }
-            for (particle_inner = 0; particle_inner <= particle; particle_inner++)
-            {
-                if (particle_inner == particle)
-                {   /*
-                    Particle distance from itself is always 0. Exclude.
-                    */
-                    safe_distance = true;   // Can probably be removed.
-                    continue;
-                }
-                particle_distance =
-                    arma::norm((pos_current.col(particle) - pos_current.col(particle_inner)));
-                if (particle_distance > a)
-                {   /*
-                    Check with the next particle if the distance is
-                    greater than 'a'.
-                    */
-                    continue;
-                }
-                else if (particle_distance <= a)
-                {   /*
-                    If the distance between particle 'particle' and
-                    'particle_inner' is less than 'a', redraw the
-                    position of particle 'particle' and check again with
-                    all particles.
-                    */
-                    break;
-                }
-                safe_distance = true;
+                walker.pos_current(dim, particle) =
+                    2*walker.random.normal()*sqrt(time_step);
             }
-        }
-    }
-    for (particle = 0; particle < n_particles; particle++)
-    {
-        qforce_current.col(particle) = quantum_force_ptr(
-            pos_current,
-            alpha,
-            beta,
-            particle,
-            n_particles
-        );
+        } while (overlaps(walker.pos_current, particle));
     }
+}
 
-    wave_current = wave_function_ptr(
-        pos_current,  // Position of all particles.
-        alpha,
-        beta,
-        n_particles
-    );
+template <int dims, bool interaction_t>
+bool ImportanceSampling::metropolis_step(
+    Walker &walker,
+    const int particle,
+    const double alpha
+)
+{   /*
+    Propose a move of a single particle drifted by the quantum force
+    (Langevin equation) and perform the Metropolis-Hastings test.
 
-    #pragma omp parallel\
-        private(mc, particle, dim, particle_inner, bin) \
-        private(wave_new) \
-        firstprivate(wave_current, local_energy) \
-        firstprivate(pos_new, qforce_new, pos_current, qforce_current) \
-        reduction(+:acceptance, energy_expectation, energy_expectation_squared) \
-        reduction(+:wave_times_energy_expectation, wave_derivative_expectation) \
-        firstprivate(wave_derivative, particle_per_bin_count_thread) \
-        private(engine)
-    {
-        #ifdef _OPENMP
-            engine.seed(seed + omp_get_thread_num());
-        #endif
+    Parameters
+    ----------
+    walker : Walker reference
+        The walker to move.
 
-        #pragma omp for
-        for (mc = 0; mc < n_mc_cycles; mc++)
-        {   /*
-            Run over all Monte Carlo cycles.
-            */
-            for (particle = 0; particle < n_particles; particle++)
-            {   /*
-                Iterate over all particles.  In this loop, new
-                proposed positions are calculated.
-                */
-                for (dim = 0; dim < n_dims; dim++)
-                {   /*
-                    Set new positions.
-                    */
-                    pos_new(dim, particle) = pos_current(dim, particle) +
-                        diffusion_coeff*qforce_current(dim, particle)*time_step +
-                        normal(engine)*sqrt(time_step);
-                }
+    particle : constant integer
+        Index of the particle to move.
 
-                qforce_new.col(particle) = quantum_force_ptr(
-                    pos_new,
-                    alpha,
-                    beta,
-                    particle,
-                    n_particles
-                );
-
-                wave_new = wave_function_ptr(
-                        pos_new,  // Particle positions.
-                        alpha,
-                        beta,
-                        n_particles
-                    );
-
-                double greens_ratio = 0;
-                for (dim = 0; dim < n_dims; dim++)
-                {   /*
-                    Calculate greens ratio for the acceptance criterion.
-                    */
-                    greens_ratio +=
-                        0.5*(qforce_current(dim, particle) + qforce_new(dim, particle))
-                        *(0.5*diffusion_coeff*time_step*
-                        (qforce_current(dim, particle) - qforce_new(dim, particle))
-                        - pos_new(dim, particle) + pos_current(dim, particle));
-                }
+    alpha : constant double
+        Current variational parameter.
 
-                greens_ratio = exp(greens_ratio);
-
-                double wave_ratio = wave_new/wave_current;
-                wave_ratio *= wave_ratio;
-
-                if (uniform(engine) < greens_ratio*wave_ratio)
-                {   /*
-                    Metropolis check.
-                    */
-                    acceptance++;    // Debug.
-                    pos_current.col(particle) = pos_new.col(particle);
-                    qforce_current.col(particle) = qforce_new.col(particle);
-                    wave_current = wave_new;
-
-                    local_energy = 0;   // Overwrite local energy from previous particle step.
-                    for (particle_inner = 0; particle_inner < n_particles; particle_inner++)
-                    {   /*
-                        After moving one particle, the local energy is
-                        calculated based on all particle positions.
-                        */
-                        local_energy += local_energy_ptr(
-                            pos_current,
-                            alpha,
-                            beta,
-                            particle_inner,
-                            n_particles
-                        );
-                    }
-                    wave_derivative = 0;
-                    for (particle_inner = 0; particle_inner < n_particles; particle_inner++)
-                    {   /*
-                        Calculations needed for gradient descent.
-                        */
-                        wave_derivative += wave_function_diff_wrt_alpha_ptr(
-                            pos_current.col(particle_inner),
-                            alpha,
-                            beta
-                        );
-                    }
-                }
+    Returns
+    -------
+    : boolean
+        True if the move was accepted.
+    */
+    int dim;
+
+    // With interaction the force on this particle depends on the
+    // positions of the others, which may have moved since it was
+    // last calculated.
+    quantum_force<dims, interaction_t>(
+        walker.qforce_current,
+        walker.pos_current,
+        walker.distances,
+        particle,
+        alpha
+    );
 
-                // GD specifics.
-                wave_derivative_expectation += wave_derivative;
-                wave_times_energy_expectation += wave_derivative*local_energy;
-                // GD specifics end.
+    for (dim = 0; dim < dims; dim++)
+    {   /*
+        Set new positions.
+        */
+        walker.pos_new(dim, particle) = walker.pos_current(dim, particle) +
+            diffusion_coeff*walker.qforce_current(dim, particle)*time_step +
+            walker.random.normal()*sqrt(time_step);
+    }
+    if constexpr (interaction_t) walker.distances.move(walker.pos_new, particle);
+
+    quantum_force<dims, interaction_t>(
+        walker.qforce_new,
+        walker.pos_new,
+        walker.distances,
+        particle,
+        alpha
+    );
 
-                // One-body density.
-                particle_distance = arma::norm(pos_current.col(particle), 2);
-                for (bin = 0; bin < n_bins - 1; bin++)
-                {
-                    if (
-                        (particle_distance >= bin_locations(bin)) and
-                        (particle_distance <  bin_locations(bin + 1))
-                    )
-                    {
-                        particle_per_bin_count_thread(bin) += 1;
-                        break;  // No need to continue checking for this particle!
-                    }
-                }
-                // One-body density end.
-                energy_expectation += local_energy;
-                energy_expectation_squared += local_energy*local_energy;
-            }
-            energies(mc, variation) = local_energy;
-        }
-        #pragma omp critical
+    double log_greens_ratio = 0;
+    for (dim = 0; dim < dims; dim++)
+    {   /*
+        Calculate greens ratio for the acceptance criterion.
+        */
+        log_greens_ratio +=
+            0.5*(walker.qforce_current(dim, particle) + walker.qforce_new(dim, particle))
+            *(0.5*diffusion_coeff*time_step*
+            (walker.qforce_current(dim, particle) - walker.qforce_new(dim, particle))
+            - walker.pos_new(dim, particle) + walker.pos_current(dim, particle));
+    }
+
+    // Metropolis-Hastings ratio, combined in the log domain so that
+    // neither factor can under- or overflow on its own.
+    const double log_wave_ratio = wave_function_log_ratio<dims, interaction_t>(walker, particle, alpha);
+
+    if (walker.random.uniform() < std::exp(log_greens_ratio + 2*log_wave_ratio))
+    {   /*
+        Metropolis check.
+        */
+        for (dim = 0; dim < dims; dim++)
         {
-            particle_per_bin_count.col(variation) += particle_per_bin_count_thread;
+            walker.qforce_current(dim, particle) = walker.qforce_new(dim, particle);
         }
-    }   // Parallel end.
-
-    acceptances(variation) = acceptance;    // Debug.
-    energy_expectation /= n_mc_cycles;
-    energy_expectation /= n_particles;
-    energy_expectation_squared /= n_particles;
-    energy_expectation_squared /= n_mc_cycles;
-    energy_variance = energy_expectation_squared
-        - energy_expectation*energy_expectation;
-
-    // GD specifics.
-    wave_times_energy_expectation /= n_mc_cycles;
-    wave_derivative_expectation /= n_mc_cycles;
-    // GD specifics end.
+        accept_move<dims, interaction_t>(walker, particle, alpha);
+        return true;
+    }
+    reject_move<interaction_t>(walker, particle);
+    return false;
+}
+
+void ImportanceSampling::sample_walker(
+    Walker &walker,
+    const double alpha,
+    const int n_cycles,
+    const bool resume
+)
+{   /*
+    Run a single walker for one variation with the importance sampling
+    Metropolis step. See VMC::run_walker for parameters.
+    */
+    dispatch_walker(*this, walker, alpha, n_cycles, resume);
 }
 
 GradientDescent::GradientDescent(
@@ -505,7 +339,8 @@ GradientDescent::GradientDescent(
         debug_input
     ),
     learning_rate(learning_rate_input),
-    initial_alpha(initial_alpha_input)
+    initial_alpha(initial_alpha_input),
+    optimizer(std::make_unique<GradientStep>(learning_rate_input))
 {   /*
     Class constructor.
 
@@ -529,12 +364,137 @@ GradientDescent::GradientDescent(
     importance_time_step_input : constant double
 
     */
+    accepted_step = arma::Col<double>(n_wave_parameters);
+    accepted_step.zeros();
+}
+
+void GradientDescent::set_optimizer(std::unique_ptr<Optimizer> optimizer_input)
+{   /*
+    Replace the default fixed learning rate gradient step, e.g. with
+    Adam or StochasticReconfiguration. Call before restart.
+    */
+    optimizer = std::move(optimizer_input);
+}
+
+void GradientDescent::set_optimize_beta(const bool optimize_beta_input)
+{   /*
+    Optimize beta together with alpha, starting from the beta given to
+    the constructor.  The optimizer then gets a gradient and covariance
+    matrix of length 2, so Adam must be created for 2 parameters.  Beta
+    only enters the wave function in three dimensions.
+    */
+    if (optimize_beta_input and (n_dims != 3))
+    {
+        std::cout << "Beta can only be optimized in 3 dimensions. Exiting..." << std::endl;
+        exit(0);
+    }
+    optimize_beta = optimize_beta_input;
+    set_variance_gradient(variance_objective ? 1 + optimize_beta : 0);
+}
+
+void GradientDescent::set_objective(const std::string objective_input)
+{   /*
+    Select the quantity to minimize, 'energy' (default) or 'variance'
+    of the local energy.  The variance is zero for an exact eigenstate
+    and, unlike the energy, bounded from below by a known value, which
+    makes it a robust objective far from the optimum.  Its gradient
+    needs the derivatives of the local energy, see
+    VMC::variance_cycle.  Call before restart.
+    */
+    if ((objective_input != "energy") and (objective_input != "variance"))
+    {
+        std::cout << "Unknown objective '" << objective_input << "'. Exiting..." << std::endl;
+        exit(0);
+    }
+    variance_objective = objective_input == "variance";
+    set_variance_gradient(variance_objective ? 1 + optimize_beta : 0);
+}
+
+void GradientDescent::set_line_search(const bool line_search_input)
+{   /*
+    Toggle adaptive step control on / off.  The optimizer step is scaled
+    by step_scale.  Every step is tested at the next variation: the step
+    is accepted if the objective did not rise by more than the Armijo
+    condition plus twice the combined statistical error of the two
+    points, and the optimizer takes a new step.  If the objective fell
+    by more than twice the error, the scale also grows by step_growth,
+    unless the step overshot the minimum, in which case it is halved.
+    A rejected step is taken again from the last accepted point with
+    half the scale, without calling the optimizer.  This replaces hand
+    tuning of the learning rate, which only sets the first step.
+    */
+    line_search = line_search_input;
+}
+
+void GradientDescent::set_sample_schedule(const int min_cycles_input)
+{   /*
+    Start with 'min_cycles_input' MC cycles per variation, instead of
+    n_mc_cycles, and double them whenever the gradient is not
+    significant, until the ratio of the gradient to its statistical
+    error is expected to reach gradient_significance.  Far from the
+    optimum, a crude gradient is enough.  The cycles never exceed
+    n_mc_cycles.  The final parameters are evaluated once more with
+    n_mc_cycles cycles.  0 turns the schedule off.  Call before
+    restart.
+    */
+    if (min_cycles_input > n_mc_cycles)
+    {
+        std::cout << "The minimum number of cycles must not exceed n_mc_cycles. Exiting..." << std::endl;
+        exit(0);
+    }
+    min_cycles = min_cycles_input;
+    scheduled_cycles = min_cycles;
+}
+
+double GradientDescent::objective(const int variation) const
+{
+    return variance_objective ? e_variances(variation) : e_expectations(variation);
+}
+
+double GradientDescent::objective_error(const int variation) const
+{   /*
+    Statistical error of the objective.  The error of the variance is
+    sqrt(2) sigma times the error of the energy, as for Gaussian local
+    energies.
+    */
+    if (!variance_objective) return e_errors(variation);
+    return std::sqrt(2*std::max(e_variances(variation), 0.0))*e_errors(variation);
+}
+
+void GradientDescent::save_state(std::ostream &outfile) const
+{
+    optimizer->save(outfile);
+    write_raw(outfile, step_scale);
+    write_raw(outfile, accepted_variation);
+    write_raw(outfile, accepted_slope);
+    write_matrix(outfile, accepted_step);
+    write_raw(outfile, scheduled_cycles);
+    write_raw(outfile, final_evaluation);
+}
+
+void GradientDescent::load_state(std::istream &infile)
+{
+    optimizer->load(infile);
+    read_raw(infile, step_scale);
+    read_raw(infile, accepted_variation);
+    read_raw(infile, accepted_slope);
+    read_matrix(infile, accepted_step);
+    read_raw(infile, scheduled_cycles);
+    read_raw(infile, final_evaluation);
 }
 
 void GradientDescent::solve(const double tol)
 {   /*
     Iterate over variational parameters.  Use gradient descent to
-    efficiently calculate alphas.
+    efficiently calculate alphas, and betas with set_optimize_beta.
+    The step is chosen by the optimizer, see set_optimizer, and scaled
+    by the line search, see set_line_search.  The energy gradient and
+    the covariance of the log derivatives are accumulated after every
+    particle step, and are thus n_particles times the values per cycle.
+    The gradient of the variance, see set_objective, is scaled the same
+    way.  With set_sample_schedule, the number of cycles grows over the
+    variations, and the final parameters are evaluated with n_mc_cycles
+    cycles.
 
     Parameters
     ----------
@@ -558,8 +518,8 @@ void GradientDescent::solve(const double tol)
         std::cout << "Quantum force is not set! Exiting..." << std::endl;
         exit(0);
     }
-    double energy_derivative = 0;
-    alphas(0) = initial_alpha;
+    if (first_variation() == 0) alphas(0) = initial_alpha;
+    const int n_optimized = optimize_beta ? 2 : 1;  // Alpha, and optionally beta.
     double comp_time;
 
     #ifdef _OPENMP
@@ -571,7 +531,10 @@ void GradientDescent::solve(const double tol)
         std::chrono::duration<double> comp_time_chrono;
     #endif
 
-    for (int variation = 0; variation < n_variations - 1; variation++)
+    // Variation of the final evaluation with a sample schedule.
+    int final_variation = final_evaluation ? first_variation() : n_variations - 1;
+
+    for (int variation = first_variation(); !final_evaluation and (variation < n_variations - 1); variation++)
     {
         #ifdef _OPENMP
             t1 = omp_get_wtime();
@@ -579,12 +542,26 @@ void GradientDescent::solve(const double tol)
             t1 = std::chrono::steady_clock::now();
         #endif
 
+        if (min_cycles > 0) chunk_cycles = scheduled_cycles;
         one_variation(variation);
         e_expectations(variation) = energy_expectation;
         e_variances(variation) = energy_variance;
+        e_errors(variation) = energy_error;
 
-        energy_derivative = 2*(wave_times_energy_expectation -
-            wave_derivative_expectation*energy_expectation);
+        // Objective gradient and covariance of the log derivatives of
+        // the optimized parameters.
+        arma::Col<double> gradient(n_optimized);
+        arma::Mat<double> covariance(n_optimized, n_optimized);
+        for (int k = 0; k < n_optimized; k++)
+        {
+            gradient(k) = variance_objective ? variance_gradient(k) : 2*(wave_times_energy_expectation(k) -
+                wave_derivative_expectation(k)*energy_expectation);
+            for (int l = 0; l < n_optimized; l++)
+            {
+                covariance(k, l) = wave_derivative_products_expectation(k, l) -
+                    wave_derivative_expectation(k)*wave_derivative_expectation(l)/n_particles;
+            }
+        }
 
         #ifdef _OPENMP
             t2 = omp_get_wtime();
@@ -595,39 +572,196 @@ void GradientDescent::solve(const double tol)
             comp_time = comp_time_chrono.count();
         #endif
 
-        alphas(variation + 1) = alphas(variation) - learning_rate*energy_derivative;
+        bool accepted = true;
+        bool decreased = false;
+        if (line_search and (accepted_variation >= 0))
+        {   /*
+            Armijo condition, loosened by twice the combined error of
+            the two objective values.
+            */
+            const double noise = std::sqrt(
+                objective_error(variation)*objective_error(variation)
+                + objective_error(accepted_variation)*objective_error(accepted_variation)
+            );
+            const double change = objective(variation) - objective(accepted_variation);
+            accepted = change <= armijo_constant*step_scale*accepted_slope + 2*noise;
+            decreased = change < -2*noise;
+        }
+
+        // The root rank decides the next parameters, so that all ranks
+        // sample the same parameters even if their sums differ in the
+        // last bit.
+        int base_variation = variation;     // The step is taken from here.
+        arma::Col<double> delta;
+        if (!line_search)
+        {
+            delta = optimizer->step(gradient, covariance);
+        }
+        else if (accepted)
+        {
+            // The gradient points back along the last step if it
+            // overshot the minimum.
+            double overshoot = 0;
+            for (int k = 0; k < n_optimized; k++) overshoot += gradient(k)*accepted_step(k);
+            if ((accepted_variation >= 0) and (overshoot > 0)) step_scale /= 2;
+            else if (decreased) step_scale *= step_growth;
+
+            const arma::Col<double> step = optimizer->step(gradient, covariance);
+            accepted_variation = variation;
+            accepted_slope = 0;
+            for (int k = 0; k < n_optimized; k++)
+            {
+                accepted_step(k) = step(k);
+                accepted_slope += gradient(k)*step(k)/n_particles;
+            }
+            delta = step_scale*step;
+        }
+        else
+        {
+            step_scale /= 2;
+            base_variation = accepted_variation;
+            delta = arma::Col<double>(n_optimized);
+            for (int k = 0; k < n_optimized; k++) delta(k) = step_scale*accepted_step(k);
+        }
+        alphas(variation + 1) = alphas(base_variation) + delta(0);
+        betas(variation + 1) = optimize_beta ? betas(base_variation) + delta(1) : betas(variation);
+        distributed_broadcast(alphas(variation + 1));
+        distributed_broadcast(betas(variation + 1));
+
+        if (min_cycles > 0)
+        {   /*
+            The error of gradient component k is estimated as
+            2 sqrt(S_kk) times the error of the objective, as for
+            uncorrelated log derivatives and local energies.  The error
+            falls as one over the square root of the cycles.
+            */
+            double gradient_norm = 0;
+            double error_norm = 0;
+            for (int k = 0; k < n_optimized; k++)
+            {
+                const double error = 2*std::sqrt(n_particles*std::max(covariance(k, k), 0.0))
+                    *objective_error(variation);
+                gradient_norm += gradient(k)*gradient(k);
+                error_norm += error*error;
+            }
+            if (gradient_norm <= 0)
+            {   // No significant gradient at any sample size, e.g. the exact wave function.
+                scheduled_cycles = n_mc_cycles;
+            }
+            else
+            {
+                const double cycles_factor =
+                    gradient_significance*gradient_significance*error_norm/gradient_norm;
+                while ((scheduled_cycles < n_mc_cycles) and (cycles_factor > 1))
+                {
+                    scheduled_cycles *= 2;
+                    if (scheduled_cycles >= cycles_factor*cycles(variation)) break;
+                }
+            }
+            scheduled_cycles = std::min(scheduled_cycles, static_cast<long>(n_mc_cycles));
+            distributed_broadcast(scheduled_cycles);
+        }
 
-        std::cout << "variation : " << std::setw(3) <<  variation;
-        std::cout << ", alpha: " << std::setw(10) << alphas(variation);
-        std::cout << ", energy: " << std::setw(10) << energy_expectation;
-        std::cout << ", variance: " << std::setw(10) << energy_variance;
-        std::cout << ", acceptance: " << std::setw(7) << acceptances(variation)/(n_mc_cycles*n_particles);
-        std::cout << ",  time : " << comp_time << "s" << std::endl;
+        if (verbose)
+        {
+            std::cout << "variation : " << std::setw(3) <<  variation;
+            std::cout << ", alpha: " << std::setw(10) << alphas(variation);
+            if (optimize_beta) std::cout << ", beta: " << std::setw(10) << betas(variation);
+            std::cout << ", energy: " << std::setw(10) << energy_expectation;
+            std::cout << ", error: " << std::setw(10) << energy_error;
+            std::cout << ", variance: " << std::setw(10) << energy_variance;
+            std::cout << ", acceptance: " << std::setw(7) << acceptances(variation)/(cycles(variation)*n_particles);
+            std::cout << ", burn-in: " << std::setw(8) << burn_in_cycles(variation);
+            if (min_cycles > 0) std::cout << ", cycles: " << std::setw(8) << cycles(variation);
+            std::cout << ",  time : " << comp_time << "s";
+            if (!accepted) std::cout << ", rejected";
+            std::cout << std::endl;
+        }
         timing(variation) = comp_time;
 
         if (debug)
         {
             std::cout << "energy_expectation: " << energy_expectation << std::endl;
-            std::cout << "wave_derivative_expectation: " << wave_derivative_expectation << std::endl;
-            std::cout << "wave_derivative_expectation*energy_expectation: " << wave_derivative_expectation*energy_expectation << std::endl;
-            std::cout << "wave_times_energy_expectation: " << wave_times_energy_expectation << std::endl;
-            std::cout << "energy_derivative: " << energy_derivative << std::endl;
+            for (int k = 0; k < n_optimized; k++)
+            {
+                std::cout << "parameter " << k << ":" << std::endl;
+                std::cout << "wave_derivative_expectation: " << wave_derivative_expectation(k) << std::endl;
+                std::cout << "wave_derivative_expectation*energy_expectation: " << wave_derivative_expectation(k)*energy_expectation << std::endl;
+                std::cout << "wave_times_energy_expectation: " << wave_times_energy_expectation(k) << std::endl;
+                std::cout << "energy_derivative: " << gradient(k) << std::endl;
+                std::cout << "wave_derivative_covariance: " << covariance(k, k) << std::endl;
+            }
             std::cout << "\n";
         }
         if (variation >= 4)
         {   /*
             Run at least a few variations before breaking.
             */
-            if (std::abs(alphas(variation + 1) - alphas(variation)) < tol)
+            double max_delta = 0;
+            for (int k = 0; k < n_optimized; k++) max_delta = std::max(max_delta, std::abs(delta(k)));
+            if (max_delta < tol)
             {
                 n_variations_final = variation;
-                std::cout << "End of gradient descent reached at iteration ";
-                std::cout << n_variations_final << " of " << n_variations << ".";
-                std::cout << " Current alpha: " << alphas(variation) << ", ";
-                std::cout << "next alpha: " << alphas(variation + 1);
-                std::cout << std::endl;
+                if (verbose)
+                {
+                    std::cout << "End of gradient descent reached at iteration ";
+                    std::cout << n_variations_final << " of " << n_variations << ".";
+                    std::cout << " Current alpha: " << alphas(variation) << ", ";
+                    std::cout << "next alpha: " << alphas(variation + 1);
+                    if (optimize_beta)
+                    {
+                        std::cout << ". Current beta: " << betas(variation) << ", ";
+                        std::cout << "next beta: " << betas(variation + 1);
+                    }
+                    std::cout << std::endl;
+                }
+                final_variation = variation + 1;
                 break;
             }
         }
+        checkpoint(variation + 1, 0, 0);
+    }
+
+    if (min_cycles > 0)
+    {   /*
+        Evaluate the final parameters with n_mc_cycles cycles.
+        */
+        #ifdef _OPENMP
+            t1 = omp_get_wtime();
+        #else
+            t1 = std::chrono::steady_clock::now();
+        #endif
+
+        final_evaluation = true;
+        chunk_cycles = n_mc_cycles;
+        one_variation(final_variation);
+        e_expectations(final_variation) = energy_expectation;
+        e_variances(final_variation) = energy_variance;
+        e_errors(final_variation) = energy_error;
+        n_variations_final = final_variation + 1;
+        final_evaluation = false;
+
+        #ifdef _OPENMP
+            t2 = omp_get_wtime();
+            comp_time = t2 - t1;
+        #else
+            t2 = std::chrono::steady_clock::now();
+            comp_time_chrono = std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1);
+            comp_time = comp_time_chrono.count();
+        #endif
+        timing(final_variation) = comp_time;
+
+        if (verbose)
+        {
+            double total_cycles = 0;
+            for (int variation = 0; variation <= final_variation; variation++) total_cycles += cycles(variation);
+            std::cout << "final evaluation, alpha: " << std::setw(10) << alphas(final_variation);
+            if (optimize_beta) std::cout << ", beta: " << std::setw(10) << betas(final_variation);
+            std::cout << ", energy: " << std::setw(10) << energy_expectation;
+            std::cout << ", error: " << std::setw(10) << energy_error;
+            std::cout << ", variance: " << std::setw(10) << energy_variance;
+            std::cout << ", total cycles: " << total_cycles;
+            std::cout << ",  time : " << comp_time << "s" << std::endl;
+        }
     }
 }
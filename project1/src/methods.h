@@ -1,6 +1,8 @@
 #ifndef METHODS
 #define METHODS
 #include "VMC.h"
+#include "optimizer.h"
+#include <memory>
 
 class BruteForce : public VMC
 {
@@ -19,16 +21,25 @@ class BruteForce : public VMC
             const bool numerical_differentiation_input,
             bool debug
         );
-        void one_variation(int variation);
+        void draw_initial_positions(Walker &walker);
+        void sample_walker(
+            Walker &walker,
+            const double alpha,
+            const int n_cycles,
+            const bool resume
+        );
+        template <int dims, bool interaction_t>
+        bool metropolis_step(
+            Walker &walker,
+            const int particle,
+            const double alpha
+        );
 };
 
 class ImportanceSampling : public VMC
 {
 
     protected:
-        double wave_derivative = 0;
-        double wave_derivative_expectation = 0;
-        double wave_times_energy_expectation = 0;
         const double time_step;
     public:
         ImportanceSampling(
@@ -42,7 +53,19 @@ class ImportanceSampling : public VMC
             const bool numerical_differentiation_input,
             bool debug_input
         );
-        void one_variation(int variation);
+        void draw_initial_positions(Walker &walker);
+        void sample_walker(
+            Walker &walker,
+            const double alpha,
+            const int n_cycles,
+            const bool resume
+        );
+        template <int dims, bool interaction_t>
+        bool metropolis_step(
+            Walker &walker,
+            const int particle,
+            const double alpha
+        );
 };
 
 class GradientDescent : public ImportanceSampling
@@ -50,6 +73,31 @@ class GradientDescent : public ImportanceSampling
     private:
         const double learning_rate;
         const double initial_alpha;
+        std::unique_ptr<Optimizer> optimizer;
+        bool optimize_beta = false;
+        bool variance_objective = false;    // Minimize the energy variance instead of the energy.
+
+        // Line search parameters.
+        bool line_search = false;
+        const double step_growth = 2;       // Step scale factor after an accepted step.
+        const double armijo_constant = 0.5; // At most a Newton step for a quadratic objective.
+        double step_scale = 1;              // Multiplies the optimizer step.
+        int accepted_variation = -1;        // Last accepted variation. -1 before the first.
+        double accepted_slope = 0;          // Objective gradient times the accepted step.
+        arma::Col<double> accepted_step;    // Optimizer step from the accepted variation.
+        // Line search parameters end.
+
+        // Sample schedule parameters.
+        int min_cycles = 0;                 // MC cycles of the first variation. 0 for off.
+        const double gradient_significance = 3; // Target ratio of the gradient to its error.
+        long scheduled_cycles = 0;          // MC cycles of the next variation.
+        bool final_evaluation = false;      // The final evaluation is running.
+        // Sample schedule parameters end.
+
+        void save_state(std::ostream &outfile) const;
+        void load_state(std::istream &infile);
+        double objective(const int variation) const;
+        double objective_error(const int variation) const;
     public:
         GradientDescent(
             const int n_dims_input,
@@ -63,6 +111,11 @@ class GradientDescent : public ImportanceSampling
             const bool numerical_differentiation_input,
             bool debug_input
         );
+        void set_optimizer(std::unique_ptr<Optimizer> optimizer_input);
+        void set_optimize_beta(const bool optimize_beta_input);
+        void set_objective(const std::string objective_input);
+        void set_line_search(const bool line_search_input);
+        void set_sample_schedule(const int min_cycles_input);
         void solve(const double tol);
 };
 
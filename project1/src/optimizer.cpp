@@ -0,0 +1,128 @@
+#include "optimizer.h"
+#include "checkpoint.h"
+#include <cmath>
+#include <iostream>
+
+GradientStep::GradientStep(const double learning_rate_input)
+    : learning_rate(learning_rate_input)
+{}
+
+arma::Col<double> GradientStep::step(
+    const arma::Col<double> &gradient,
+    const arma::Mat<double> & /* covariance */
+)
+{
+    return -learning_rate*gradient;
+}
+
+Adam::Adam(
+    const int n_parameters,
+    const double learning_rate_input,
+    const double beta_1_input,
+    const double beta_2_input,
+    const double epsilon_input
+) : learning_rate(learning_rate_input),
+    beta_1(beta_1_input),
+    beta_2(beta_2_input),
+    epsilon(epsilon_input)
+{   /*
+    Class constructor.
+
+    Parameters
+    ----------
+    n_parameters : constant integer
+        The number of variational parameters.
+
+    learning_rate_input : constant double
+        Approximate step size of every parameter.
+
+    beta_1_input, beta_2_input : constant double
+        Decay rates of the running averages of the gradient and of the
+        squared gradient.
+
+    epsilon_input : constant double
+        Guards the division by the root of the squared gradient.
+    */
+    moment_1 = arma::Col<double>(n_parameters);
+    moment_2 = arma::Col<double>(n_parameters);
+    moment_1.zeros();
+    moment_2.zeros();
+}
+
+arma::Col<double> Adam::step(
+    const arma::Col<double> &gradient,
+    const arma::Mat<double> & /* covariance */
+)
+{
+    iteration++;
+    const double correction_1 = 1 - std::pow(beta_1, iteration);
+    const double correction_2 = 1 - std::pow(beta_2, iteration);
+
+    arma::Col<double> delta(gradient.n_elem);
+    for (arma::uword parameter = 0; parameter < gradient.n_elem; parameter++)
+    {
+        moment_1(parameter) = beta_1*moment_1(parameter) + (1 - beta_1)*gradient(parameter);
+        moment_2(parameter) = beta_2*moment_2(parameter)
+            + (1 - beta_2)*gradient(parameter)*gradient(parameter);
+        delta(parameter) = -learning_rate*(moment_1(parameter)/correction_1)
+            /(std::sqrt(moment_2(parameter)/correction_2) + epsilon);
+    }
+    return delta;
+}
+
+void Adam::save(std::ostream &outfile) const
+{
+    write_matrix(outfile, moment_1);
+    write_matrix(outfile, moment_2);
+    write_raw(outfile, iteration);
+}
+
+void Adam::load(std::istream &infile)
+{
+    read_matrix(infile, moment_1);
+    read_matrix(infile, moment_2);
+    read_raw(infile, iteration);
+}
+
+StochasticReconfiguration::StochasticReconfiguration(
+    const double learning_rate_input,
+    const double regularization_input
+) : learning_rate(learning_rate_input),
+    regularization(regularization_input)
+{   /*
+    Class constructor.
+
+    Parameters
+    ----------
+    learning_rate_input : constant double
+        Fraction of the natural gradient step to take. About 0.5 - 1.
+
+    regularization_input : constant double
+        Relative shift of the diagonal of S, e.g. 1e-3.
+    */
+}
+
+arma::Col<double> StochasticReconfiguration::step(
+    const arma::Col<double> &gradient,
+    const arma::Mat<double> &covariance
+)
+{
+    arma::Mat<double> shifted = covariance;
+    for (arma::uword parameter = 0; parameter < shifted.n_rows; parameter++)
+    {
+        shifted(parameter, parameter) *= 1 + regularization;
+    }
+
+    // The natural gradient solves S delta = <O E> - <O><E>, which is
+    // half the energy gradient.
+    arma::Col<double> delta(gradient.n_elem);
+    if (!arma::solve(delta, shifted, 0.5*gradient))
+    {   /*
+        S is singular, e.g. when the wave function is exact and all
+        log derivatives are constant. The gradient is then zero too.
+        */
+        std::cout << "Stochastic reconfiguration: singular S, no step taken." << std::endl;
+        delta.zeros();
+    }
+    return -learning_rate*delta;
+}
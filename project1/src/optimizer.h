@@ -0,0 +1,100 @@
+#ifndef OPTIMIZER
+#define OPTIMIZER
+
+#include <istream>
+#include <ostream>
+#include <armadillo>
+
+class Optimizer
+{   /*
+    Update rule for the variational parameters of GradientDescent.
+    After every variation, step gets the energy gradient and the
+    covariance matrix S_kl = <O_k O_l> - <O_k><O_l> of the log
+    derivatives O_k = d ln(psi)/d theta_k of the wave function, and
+    returns the change of the parameters.  Both are summed over the
+    particle steps of a cycle, see GradientDescent::solve, which only
+    scales the plain gradient step.  save and load write the optimizer
+    state to a checkpoint.
+    */
+    public:
+        virtual ~Optimizer() {}
+        virtual arma::Col<double> step(
+            const arma::Col<double> &gradient,
+            const arma::Mat<double> &covariance
+        ) = 0;
+        virtual void save(std::ostream & /* outfile */) const {}
+        virtual void load(std::istream & /* infile */) {}
+};
+
+class GradientStep : public Optimizer
+{   /*
+    Plain gradient descent with a fixed learning rate.
+    */
+    private:
+        const double learning_rate;
+
+    public:
+        GradientStep(const double learning_rate_input);
+        arma::Col<double> step(
+            const arma::Col<double> &gradient,
+            const arma::Mat<double> &covariance
+        );
+};
+
+class Adam : public Optimizer
+{   /*
+    Adam: gradient descent with bias corrected running averages of the
+    gradient and of its square (Kingma & Ba, 2014).  The step of every
+    parameter is about 'learning_rate', independent of the scale of the
+    gradient.
+    */
+    private:
+        const double learning_rate;
+        const double beta_1;
+        const double beta_2;
+        const double epsilon;
+        arma::Col<double> moment_1;     // Running average of the gradient.
+        arma::Col<double> moment_2;     // Running average of the squared gradient.
+        long iteration = 0;
+
+    public:
+        Adam(
+            const int n_parameters,
+            const double learning_rate_input,
+            const double beta_1_input = 0.9,
+            const double beta_2_input = 0.999,
+            const double epsilon_input = 1e-8
+        );
+        arma::Col<double> step(
+            const arma::Col<double> &gradient,
+            const arma::Mat<double> &covariance
+        );
+        void save(std::ostream &outfile) const;
+        void load(std::istream &infile);
+};
+
+class StochasticReconfiguration : public Optimizer
+{   /*
+    Stochastic reconfiguration, or natural gradient descent: solve
+    (S + shift) delta = gradient/2, with S the covariance matrix of the
+    log derivatives, and step by -learning_rate*delta.  S measures how
+    much the wave function changes with each parameter, which makes the
+    step nearly independent of the parametrization.  For the Gaussian
+    trial function in a harmonic trap, a learning rate of 0.5 is a
+    Newton step, and converges in a few iterations.  The diagonal of S is
+    scaled by 1 + regularization to stabilize the solve when S is
+    poorly estimated.
+    */
+    private:
+        const double learning_rate;
+        const double regularization;
+
+    public:
+        StochasticReconfiguration(const double learning_rate_input, const double regularization_input);
+        arma::Col<double> step(
+            const arma::Col<double> &gradient,
+            const arma::Mat<double> &covariance
+        );
+};
+
+#endif
@@ -1,5 +1,28 @@
 #include "parameters.h"
-/*
-Dummy file to make the compilator happy. Probably a more correct way to
-do this, but I don't know how.
-*/
\ No newline at end of file
+
+double omega = 1;
+double a = 0.0043;
+double gamma_ = 2.82843;
+double omega_z = gamma_*omega;
+
+void set_parameters(const double omega_input, const double a_input, const double gamma_input)
+{   /*
+    Set the trap and interaction parameters. Not thread safe, call
+    before solve.
+
+    Parameters
+    ----------
+    omega_input : constant double
+        Trap frequency in the xy-plane.
+
+    a_input : constant double
+        Hard-sphere radius of the bosons.
+
+    gamma_input : constant double
+        Ratio omega_z/omega of the elliptic trap.
+    */
+    omega = omega_input;
+    a = a_input;
+    gamma_ = gamma_input;
+    omega_z = gamma_*omega;
+}
@@ -3,9 +3,14 @@
 
 const double hbar = 1;
 const double m = 1;
-const double omega = 1;
-const double a = 0.0043;
-const double gamma_ = 2.82843;  // Shoud = beta.
-const double omega_z = gamma_*omega;
 
-#endif
\ No newline at end of file
+// Trap and interaction parameters. Defaults in parameters.cpp, changed
+// at run time with set_parameters before any sampling starts.
+extern double omega;
+extern double a;
+extern double gamma_;   // Shoud = beta.
+extern double omega_z;
+
+void set_parameters(const double omega_input, const double a_input, const double gamma_input);
+
+#endif
@@ -0,0 +1,228 @@
+#ifndef PHILOX
+#define PHILOX
+
+#include <cstdint>
+#include <limits>
+
+class Philox
+{   /*
+    Philox4x32-10 counter-based random number generator (Salmon et al.,
+    "Parallel random numbers: as easy as 1, 2, 3", SC11).
+
+    The output is a bijective function of a 128-bit counter and a 64-bit
+    key, so there is no sequential state to carry between draws.  The
+    key is the RNG seed, the upper half of the counter is the stream
+    index and the lower half counts blocks within the stream.  Every
+    walker gets its own stream, so the numbers a walker draws do not
+    depend on which thread runs it, and skip() jumps ahead any number of
+    blocks in O(1).
+
+    Fulfills the UniformRandomBitGenerator requirements, so it can be
+    used with the <random> distributions.  Each block gives four 32-bit
+    words, which are handed out as two 64-bit numbers.
+
+    Defined in the header so that the generator is inlined in the
+    sampling loops.
+    */
+    public:
+        typedef std::uint64_t result_type;
+
+        Philox()
+        {
+            seed(0, 0);
+        }
+
+        Philox(const std::uint64_t seed_input, const std::uint64_t stream = 0)
+        {
+            seed(seed_input, stream);
+        }
+
+        void seed(const std::uint64_t seed_input, const std::uint64_t stream = 0)
+        {   /*
+            Set the key and select a stream. The block counter is reset.
+
+            Parameters
+            ----------
+            seed_input : constant 64-bit unsigned integer
+                RNG seed. Used as the Philox key.
+
+            stream : constant 64-bit unsigned integer
+                Stream index, eg. the walker index.
+            */
+            key[0] = static_cast<std::uint32_t>(seed_input);
+            key[1] = static_cast<std::uint32_t>(seed_input >> 32);
+            counter[0] = 0;
+            counter[1] = 0;
+            counter[2] = static_cast<std::uint32_t>(stream);
+            counter[3] = static_cast<std::uint32_t>(stream >> 32);
+            index = 2;  // Empty output buffer.
+        }
+
+        void skip(const std::uint64_t n_blocks)
+        {   /*
+            Jump 'n_blocks' blocks (2*n_blocks outputs) ahead in the
+            current stream. Any buffered output is discarded.
+
+            Parameters
+            ----------
+            n_blocks : constant 64-bit unsigned integer
+                Number of blocks to skip.
+            */
+            std::uint64_t block = block_counter() + n_blocks;
+            counter[0] = static_cast<std::uint32_t>(block);
+            counter[1] = static_cast<std::uint32_t>(block >> 32);
+            index = 2;
+        }
+
+        std::uint64_t block_counter() const
+        {
+            return (static_cast<std::uint64_t>(counter[1]) << 32) | counter[0];
+        }
+
+        static constexpr result_type min()
+        {
+            return 0;
+        }
+
+        static constexpr result_type max()
+        {
+            return std::numeric_limits<result_type>::max();
+        }
+
+        result_type operator()()
+        {
+            if (index == 2) generate_block();
+            return output[index++];
+        }
+
+        double uniform()
+        {   /*
+            Uniformly distributed double in [0, 1) from the 53 upper
+            bits of one output.
+            */
+            return ((*this)() >> 11)*0x1.0p-53;
+        }
+
+        void block(std::uint32_t result[4])
+        {   /*
+            Write the four 32-bit words of the current block to 'result'
+            and step to the next block. For filling buffers without
+            going through operator().
+            */
+            philox_4x32_10(counter, result);
+            skip(1);
+        }
+
+        void fill(std::uint64_t *result, const int n_blocks)
+        {   /*
+            Write the next 'n_blocks' blocks as 2*n_blocks 64-bit numbers
+            to 'result'.  The blocks are independent functions of their
+            counters, so the loop has no carried state and is
+            vectorized over blocks.  Any buffered output is discarded.
+
+            Parameters
+            ----------
+            result : 64-bit unsigned integer pointer
+                Output array of length 2*n_blocks.
+
+            n_blocks : constant integer
+                Number of blocks to generate.
+            */
+            const std::uint64_t first_block = block_counter();
+            const std::uint32_t ctr2 = counter[2];
+            const std::uint32_t ctr3 = counter[3];
+
+            #pragma omp simd
+            for (int block = 0; block < n_blocks; block++)
+            {
+                const std::uint64_t block_index = first_block + block;
+                std::uint32_t c[4] = {
+                    static_cast<std::uint32_t>(block_index),
+                    static_cast<std::uint32_t>(block_index >> 32),
+                    ctr2,
+                    ctr3
+                };
+                std::uint32_t r[4];
+                philox_4x32_10(c, r);
+                result[2*block] = (static_cast<std::uint64_t>(r[1]) << 32) | r[0];
+                result[2*block + 1] = (static_cast<std::uint64_t>(r[3]) << 32) | r[2];
+            }
+            skip(n_blocks);
+        }
+
+    private:
+        std::uint32_t key[2];
+        std::uint32_t counter[4];
+        std::uint64_t output[2];
+        int index;
+
+        static void mulhilo(
+            const std::uint32_t a,
+            const std::uint32_t b,
+            std::uint32_t &hi,
+            std::uint32_t &lo
+        )
+        {
+            const std::uint64_t product = static_cast<std::uint64_t>(a)*b;
+            hi = static_cast<std::uint32_t>(product >> 32);
+            lo = static_cast<std::uint32_t>(product);
+        }
+
+        static void philox_round(
+            std::uint32_t c[4],
+            const std::uint32_t k0,
+            const std::uint32_t k1
+        )
+        {
+            std::uint32_t hi0;
+            std::uint32_t lo0;
+            std::uint32_t hi1;
+            std::uint32_t lo1;
+
+            mulhilo(0xD2511F53, c[0], hi0, lo0);
+            mulhilo(0xCD9E8D57, c[2], hi1, lo1);
+            c[0] = hi1 ^ c[1] ^ k0;
+            c[1] = lo1;
+            c[2] = hi0 ^ c[3] ^ k1;
+            c[3] = lo0;
+        }
+
+        void philox_4x32_10(const std::uint32_t ctr[4], std::uint32_t result[4]) const
+        {   /*
+            Ten Philox rounds of 'ctr' with the current key. The key is
+            bumped with the Weyl constants between rounds.
+            */
+            const std::uint32_t w0 = 0x9E3779B9;
+            const std::uint32_t w1 = 0xBB67AE85;
+            const std::uint32_t k0 = key[0];
+            const std::uint32_t k1 = key[1];
+
+            result[0] = ctr[0];
+            result[1] = ctr[1];
+            result[2] = ctr[2];
+            result[3] = ctr[3];
+
+            philox_round(result, k0, k1);
+            philox_round(result, k0 + w0, k1 + w1);
+            philox_round(result, k0 + 2*w0, k1 + 2*w1);
+            philox_round(result, k0 + 3*w0, k1 + 3*w1);
+            philox_round(result, k0 + 4*w0, k1 + 4*w1);
+            philox_round(result, k0 + 5*w0, k1 + 5*w1);
+            philox_round(result, k0 + 6*w0, k1 + 6*w1);
+            philox_round(result, k0 + 7*w0, k1 + 7*w1);
+            philox_round(result, k0 + 8*w0, k1 + 8*w1);
+            philox_round(result, k0 + 9*w0, k1 + 9*w1);
+        }
+
+        void generate_block()
+        {
+            std::uint32_t result[4];
+            philox_4x32_10(counter, result);
+            output[0] = (static_cast<std::uint64_t>(result[1]) << 32) | result[0];
+            output[1] = (static_cast<std::uint64_t>(result[3]) << 32) | result[2];
+            skip(1);
+            index = 0;
+        }
+};
+
+#endif
@@ -1,35 +1,33 @@
 #include "quantum_force.h"
 #include "parameters.h"
 
-arma::Mat<double> quantum_force_3d_no_interaction(
+void quantum_force_3d_interaction(
+    arma::Mat<double> &force,
     const arma::Mat<double> &pos,
+    const DistanceCache &distances,
     const double alpha,
     const double beta,
     const int current_particle,
     const int n_particles
 )
 {   /*
-    Parameters
-    ----------
-    pos : arma::Mat<double> reference
-        Positions of all particles.
-    */
-    return -4*alpha*pos.col(current_particle);
-}
+    Quantum force F = 2 grad(psi)/psi for a single particle, with
+    interaction.  The one-body part gives -4 alpha (x, y, beta z) and
+    each pair (k, j) adds 2 u'(r_kj) (r_k - r_j)/r_kj, where
+    u(r) = ln(1 - a/r) so that u'(r) = a/(r(r - a)).
 
-arma::Mat<double> quantum_force_3d_interaction(
-    const arma::Mat<double> &pos,
-    const double alpha,
-    const double beta,
-    const int current_particle,
-    const int n_particles
-)
-{   /*
     Parameters
     ----------
+    force : arma::Mat<double> reference
+        Output. Column 'current_particle' is overwritten.
+
     pos : arma::Mat<double> reference
         Positions of all particles.
 
+    distances : DistanceCache reference
+        Pairwise distances and structure-of-arrays positions of all
+        particles in 'pos'.
+
     alpha : constant double
         Current variational parameter.
 
@@ -43,129 +41,42 @@ arma::Mat<double> quantum_force_3d_interaction(
         The total number of particles.
     */
 
-    int particle;       // Particle index.
-    int particle_inner; // Particle index.
-    arma::Col<double> term_1(3);
+    const double *x_all = distances.positions.colptr(0);   // Structure of arrays.
+    const double *y_all = distances.positions.colptr(1);
+    const double *z_all = distances.positions.colptr(2);
+    const double *distance_column = distances.distance.colptr(current_particle);
     const double x = pos(0, current_particle);  // Readability.
     const double y = pos(1, current_particle);
     const double z = pos(2, current_particle);
 
-    // Term 1.
-    term_1 = {x, y, z*beta};
-    term_1 *= -2*alpha*std::exp(-alpha*(x*x + y*y + z*z*beta));
-    // Term 1 end.
+    // One-body term.
+    double force_x = -2*alpha*x;
+    double force_y = -2*alpha*y;
+    double force_z = -2*alpha*beta*z;
+    // One-body term end.
 
-    // Term 2.
-    // double term_2 = 1;  // Product, not sum, thus 1.
-    double term_2 = 0;  // Sum, not product, thus 1.
-    for (particle = 0; particle < current_particle; particle++)
-    {
-        // term_2 *= std::exp(-alpha*(
-        //     pos(0, particle)*pos(0, particle) + 
-        //     pos(1, particle)*pos(1, particle) + 
-        //     pos(2, particle)*pos(2, particle)*beta
-        // ));
-        term_2 += (-alpha*(
-            pos(0, particle)*pos(0, particle) + 
-            pos(1, particle)*pos(1, particle) + 
-            pos(2, particle)*pos(2, particle)*beta
-        ));
-    }
-    
-    for (particle = current_particle + 1; particle < n_particles; particle++)
-    {
-        // term_2 *= std::exp(-alpha*(
-        //     pos(0, particle)*pos(0, particle) + 
-        //     pos(1, particle)*pos(1, particle) + 
-        //     pos(2, particle)*pos(2, particle)*beta
-        // ));
-        term_2 += (-alpha*(
-            pos(0, particle)*pos(0, particle) + 
-            pos(1, particle)*pos(1, particle) + 
-            pos(2, particle)*pos(2, particle)*beta
-        ));
-    }
-    // Term 2 end.
-
-    // Term 3.
-    double term_3 = 0;  // Sum, not product, thus 0.
-    double particle_distance;
-    for (particle = 0; particle < n_particles; particle++)
-    {   /*
-        exp( sum( u( |r_i - r_j| ) ) )
-        */
-        for (particle_inner = particle + 1; particle_inner < n_particles; particle_inner++)
-        {
-            particle_distance =
-                arma::norm(pos.col(particle) - pos.col(particle_inner), 2);
-            
-            if (particle_distance > a)
-            {   /*
-                Interaction if the particle spacing is greater than 'a'.
-                NB: Not explicity stating what happens when
-                particle_distance < a. Then, the term is 0.
-                */
-                term_3 += std::log(1 - a/particle_distance);
-            }
-        }
-    }
-    term_3 = std::exp(term_3);
-    // Term 3 end.
-
-    // Term 4.
-    double term_4 = 1;  // Product, not sum, thus 1.
-    for (particle = 0; particle < n_particles; particle++)
+    // Interaction term.
+    #pragma omp simd reduction(+:force_x, force_y, force_z)
+    for (int particle = 0; particle < n_particles; particle++)
     {   /*
-        TODO: Consider using the calculation for term_2 for this term.
+        Interaction if the particle spacing is greater than 'a'.
+        NB: Not explicity stating what happens when
+        particle_distance < a. Then, the term is 0.  This also removes
+        the particle itself, which has spacing 0.  Branch-free so that
+        the loop vectorizes.
         */
-
-        term_4 *= std::exp(-alpha*(
-            pos(0, particle)*pos(0, particle) + 
-            pos(1, particle)*pos(1, particle) + 
-            pos(2, particle)*pos(2, particle)*beta
-        ));
+        const bool interacting = distance_column[particle] > a;
+        const double particle_distance = interacting ? distance_column[particle] : 2*a;
+        const double u_diff = interacting ?
+            a/(particle_distance*particle_distance*(particle_distance - a)) : 0;
+
+        force_x += u_diff*(x - x_all[particle]);
+        force_y += u_diff*(y - y_all[particle]);
+        force_z += u_diff*(z - z_all[particle]);
     }
-    // Term 4 end.
+    // Interaction term end.
 
-    // Term 5.
-    double term_5 = term_3;
-    // Term 5 end.
-
-    // Term 6.
-    arma::Col<double> term_6(3);
-    arma::Col<double> tmp(3);
-    term_6.zeros(); // Sum, not product, thus 0.
-    for (particle = 0; particle < current_particle; particle++)
-    {
-        particle_distance =
-            arma::norm(pos.col(particle) - pos.col(current_particle), 2);
-
-        if (particle_distance > a)
-        {   /*
-            Interaction if the particle spacing is greater than 'a'.
-            NB: Not explicity stating what happens when
-            particle_distance < a. Then, the term is 0.
-            */
-            tmp = {
-                pos(0, particle) - x,
-                pos(1, particle) - y,
-                pos(2, particle) - z
-            };
-            tmp *=
-                1/(1 - a/particle_distance)*a*std::pow(particle_distance, -3);
-
-            term_6 += tmp;
-        }
-    }
-    // Term 6 end.
-
-    double wave_function = wave_function_3d_interaction_with_loop(
-        pos,
-        alpha,
-        beta,
-        n_particles
-    );
-
-    return 2*(term_1*std::exp(term_2)*term_3 + term_4*term_5*term_6)/wave_function;
-    // return 2*(term_1*term_2*term_3 + term_4*term_5*term_6)/std::exp(wave_function);
-}
\ No newline at end of file
+    force(0, current_particle) = 2*force_x;
+    force(1, current_particle) = 2*force_y;
+    force(2, current_particle) = 2*force_z;
+}
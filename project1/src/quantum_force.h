@@ -2,19 +2,48 @@
 #define QUANTUM
 #include "VMC.h"
 
-arma::Mat<double> quantum_force_3d_no_interaction(
+void quantum_force_3d_interaction(
+    arma::Mat<double> &force,
     const arma::Mat<double> &pos,
+    const DistanceCache &distances,
     const double alpha,
     const double beta,
     const int current_particle,
     const int n_particles
 );
-arma::Mat<double> quantum_force_3d_interaction(
+
+template <int n_dims>
+inline void quantum_force_no_interaction(
+    arma::Mat<double> &force,
     const arma::Mat<double> &pos,
+    const DistanceCache &distances,
     const double alpha,
     const double beta,
     const int current_particle,
     const int n_particles
-);
+)
+{   /*
+    Quantum force F = 2 grad(psi)/psi = -4 alpha (x, y, beta z) for a
+    single particle, without interaction.
+
+    Parameters
+    ----------
+    force : arma::Mat<double> reference
+        Output. Column 'current_particle' is overwritten.
+
+    pos : arma::Mat<double> reference
+        Positions of all particles.
+
+    distances : DistanceCache reference
+        Pairwise distances. Not in use without interaction.
+    */
+    const double *r = pos.colptr(current_particle);
+    double *f = force.colptr(current_particle);
+
+    for (int dim = 0; dim < n_dims; dim++)
+    {
+        f[dim] = -4*alpha*((dim == 2) ? beta : 1)*r[dim];
+    }
+}
 
 #endif
\ No newline at end of file
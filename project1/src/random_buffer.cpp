@@ -0,0 +1,75 @@
+#include "random_buffer.h"
+
+RandomBuffer::RandomBuffer()
+{   /*
+    Class constructor. Seed 0, stream 0.
+    */
+    seed(0, 0);
+}
+
+void RandomBuffer::seed(const std::uint64_t seed_input, const std::uint64_t stream)
+{   /*
+    Seed the underlying Philox generator and discard buffered numbers.
+
+    Parameters
+    ----------
+    seed_input : constant 64-bit unsigned integer
+        RNG seed.
+
+    stream : constant 64-bit unsigned integer
+        Stream index, eg. the walker index.
+    */
+    engine.seed(seed_input, stream);
+    uniform_index = buffer_size;
+    normal_index = buffer_size;
+}
+
+void RandomBuffer::skip(const std::uint64_t n_blocks)
+{   /*
+    Jump 'n_blocks' Philox blocks ahead and discard buffered numbers.
+    */
+    engine.skip(n_blocks);
+    uniform_index = buffer_size;
+    normal_index = buffer_size;
+}
+
+void RandomBuffer::fill_uniform()
+{   /*
+    Refill the uniform buffer with numbers in [0, 1), from the 53 upper
+    bits of each 64-bit output.
+    */
+    engine.fill(raw, buffer_size/2);
+
+    #pragma omp simd
+    for (int i = 0; i < buffer_size; i++)
+    {
+        uniforms[i] = (raw[i] >> 11)*0x1.0p-53;
+    }
+    uniform_index = 0;
+}
+
+void RandomBuffer::fill_normal()
+{   /*
+    Refill the normal buffer with the Box-Muller transform. Each pair of
+    uniforms (u_1, u_2) gives the pair of independent normals
+    sqrt(-2 ln u_1) cos(2 pi u_2) and sqrt(-2 ln u_1) sin(2 pi u_2).
+    */
+    const double two_pi = 6.283185307179586;
+    const int n_pairs = buffer_size/2;
+
+    engine.fill(raw, buffer_size/2);
+
+    #pragma omp simd
+    for (int i = 0; i < n_pairs; i++)
+    {
+        // u_1 in (0, 1] so that the logarithm is finite.
+        const double u_1 = ((raw[2*i] >> 11) + 1)*0x1.0p-53;
+        const double u_2 = (raw[2*i + 1] >> 11)*0x1.0p-53;
+        const double radius = std::sqrt(-2*std::log(u_1));
+        const double theta = two_pi*u_2;
+
+        normals[i] = radius*std::cos(theta);
+        normals[n_pairs + i] = radius*std::sin(theta);
+    }
+    normal_index = 0;
+}
@@ -0,0 +1,57 @@
+#ifndef RANDOM_BUFFER
+#define RANDOM_BUFFER
+
+#include <cmath>
+#include <cstdint>
+#include "philox.h"
+
+class RandomBuffer
+{   /*
+    Buffered uniform and normal random numbers for one walker.  Instead
+    of drawing one number at a time through the <random> distributions,
+    blocks of 'buffer_size' numbers are generated at once: the Philox
+    outputs with Philox::fill, and the normals with a branch-free
+    Box-Muller transform over the whole block.  Both loops are written
+    so that the compiler can vectorize them.  The proposal loops then
+    only read the next element of a buffer.
+
+    The numbers only depend on the seed and stream, so a walker draws
+    the same sequence regardless of thread.
+    */
+    public:
+        static const int buffer_size = 512;    // Must be even.
+
+        RandomBuffer();
+        void seed(const std::uint64_t seed_input, const std::uint64_t stream);
+        void skip(const std::uint64_t n_blocks);
+
+        double uniform()
+        {   /*
+            Uniformly distributed number in [0, 1).
+            */
+            if (uniform_index == buffer_size) fill_uniform();
+            return uniforms[uniform_index++];
+        }
+
+        double normal()
+        {   /*
+            Normally distributed number with mean 0 and standard
+            deviation 1.
+            */
+            if (normal_index == buffer_size) fill_normal();
+            return normals[normal_index++];
+        }
+
+    private:
+        Philox engine;
+        int uniform_index;
+        int normal_index;
+        std::uint64_t raw[buffer_size];
+        double uniforms[buffer_size];
+        double normals[buffer_size];
+
+        void fill_uniform();
+        void fill_normal();
+};
+
+#endif
@@ -0,0 +1,607 @@
+#ifndef SAMPLER
+#define SAMPLER
+
+#include "VMC.h"
+#include "wave_function.h"
+#include "local_energy.h"
+#include "quantum_force.h"
+
+/*
+The Monte Carlo sampler of the VMC class, templated on the number of
+spatial dimensions 'dims' and on interaction 'interaction_t'.  The
+kernels are chosen at compile time, so the per-particle loops have a
+fixed length and the kernel calls are direct (and for the
+non-interacting kernels, inlined) instead of going through function
+pointers.  The run time choice is made once per walker and variation in
+VMC::dispatch_walker.  Include only from the sampling methods, which
+instantiate the templates with their own metropolis_step.
+*/
+
+template <int dims, bool interaction_t>
+double VMC::wave_function_log_ratio(Walker &walker, const int particle, const double alpha)
+{   /*
+    ln(psi_new/psi_current) when only 'particle' has moved. The distance
+    cache of 'walker' must hold the proposed distances.  The samplers
+    work with the logarithm throughout, since psi itself under- or
+    overflows for large numbers of particles.
+    */
+    if constexpr (interaction_t)
+    {
+        return wave_function_3d_interaction_log_ratio(
+            walker.pos_new,
+            walker.pos_current,
+            walker.distances,
+            alpha,
+            beta,
+            particle,
+            n_particles
+        );
+    }
+    else
+    {
+        return wave_function_no_interaction_log_ratio<dims>(
+            walker.pos_new,
+            walker.pos_current,
+            walker.distances,
+            alpha,
+            beta,
+            particle,
+            n_particles
+        );
+    }
+}
+
+template <int dims, bool interaction_t>
+void VMC::quantum_force(
+    arma::Mat<double> &force,
+    const arma::Mat<double> &pos,
+    const DistanceCache &distances,
+    const int particle,
+    const double alpha
+)
+{   /*
+    Calculate the quantum force of 'particle' into column 'particle' of
+    'force'.
+
+    Parameters
+    ----------
+    force : arma::Mat<double> reference
+        Output.
+
+    pos : arma::Mat<double> reference
+        Positions of all particles.
+
+    distances : DistanceCache reference
+        Pairwise distances of all particles in 'pos'.
+
+    particle : constant integer
+        Index of the particle.
+
+    alpha : constant double
+        Current variational parameter.
+    */
+    if constexpr (interaction_t)
+    {
+        quantum_force_3d_interaction(
+            force,
+            pos,
+            distances,
+            alpha,
+            beta,
+            particle,
+            n_particles
+        );
+    }
+    else
+    {
+        quantum_force_no_interaction<dims>(
+            force,
+            pos,
+            distances,
+            alpha,
+            beta,
+            particle,
+            n_particles
+        );
+    }
+}
+
+template <int dims, bool interaction_t>
+double VMC::local_energy_total(
+    const arma::Mat<double> &pos,
+    const DistanceCache &distances,
+    const double alpha,
+    const double beta
+)
+{   /*
+    Total local energy of all particles. Falls back to the kernels set
+    by set_local_energy with interaction or numerical differentiation.
+    */
+    if (interaction_t or numerical_differentiation)
+    {
+        return local_energy_total(pos, distances, alpha, beta);
+    }
+
+    double res = 0;
+    for (int particle = 0; particle < n_particles; particle++)
+    {
+        res += local_energy_no_interaction<dims>(
+            pos,
+            distances,
+            alpha,
+            beta,
+            particle,
+            n_particles
+        );
+    }
+    return res;
+}
+
+template <int dims, bool interaction_t>
+void VMC::initialize_walker(Walker &walker, const double alpha)
+{   /*
+    Draw initial positions for a walker and calculate everything that
+    is derived from them: distances, quantum forces, local energy and
+    the log derivatives of the wave function.
+
+    Parameters
+    ----------
+    walker : Walker reference
+        The walker to initialize.
+
+    alpha : constant double
+        Current variational parameter.
+    */
+    draw_initial_positions(walker);
+    if constexpr (interaction_t) walker.distances.compute(walker.pos_current);
+
+    walker.wave_derivative.fill(0);
+    for (int particle = 0; particle < n_particles; particle++)
+    {
+        quantum_force<dims, interaction_t>(
+            walker.qforce_current,
+            walker.pos_current,
+            walker.distances,
+            particle,
+            alpha
+        );
+        const WaveParameters derivatives = wave_function_log_derivatives<dims>(
+            walker.pos_current,
+            particle,
+            alpha,
+            beta
+        );
+        for (int k = 0; k < n_wave_parameters; k++) walker.wave_derivative[k] += derivatives[k];
+    }
+
+    walker.pos_new = walker.pos_current;  // Only the moved particle differs between the two.
+    walker.qforce_new = walker.qforce_current;
+
+    if (incremental_local_energy)
+    {
+        walker.local_energy_engine.initialize(walker.pos_current, walker.distances, alpha, beta);
+    }
+    walker.local_energy = local_energy_total<dims, interaction_t>(
+        walker.pos_current,
+        walker.distances,
+        alpha,
+        beta
+    );
+    walker.reset_accumulators();
+}
+
+template <int dims, bool interaction_t>
+void VMC::accept_move(Walker &walker, const int particle, const double alpha)
+{   /*
+    Accept the proposed move of 'particle'. Update the local energy and
+    the log derivatives of the wave function, and copy the new position into
+    pos_current.
+
+    Parameters
+    ----------
+    walker : Walker reference
+        The walker which made the move.
+
+    particle : constant integer
+        Index of the moved particle.
+
+    alpha : constant double
+        Current variational parameter.
+    */
+    const WaveParameters derivatives_new =
+        wave_function_log_derivatives<dims>(walker.pos_new, particle, alpha, beta);
+    const WaveParameters derivatives_current =
+        wave_function_log_derivatives<dims>(walker.pos_current, particle, alpha, beta);
+    for (int k = 0; k < n_wave_parameters; k++)
+    {
+        walker.wave_derivative[k] += derivatives_new[k] - derivatives_current[k];
+    }
+
+    if (incremental_local_energy)
+    {   /*
+        Update only the terms of the moved particle. Must be done before
+        pos_current is overwritten.
+        */
+        walker.local_energy_engine.move(
+            walker.pos_current,
+            walker.pos_new,
+            walker.distances,
+            particle
+        );
+        walker.local_energy = walker.local_energy_engine.get_local_energy();
+    }
+
+    for (int dim = 0; dim < dims; dim++)
+    {
+        walker.pos_current(dim, particle) = walker.pos_new(dim, particle);
+    }
+
+    if (!incremental_local_energy)
+    {   /*
+        After moving one particle, the local energy is calculated based
+        on all particle positions.
+        */
+        walker.local_energy = local_energy_total<dims, interaction_t>(
+            walker.pos_current,
+            walker.distances,
+            alpha,
+            beta
+        );
+    }
+}
+
+template <bool interaction_t>
+void VMC::reject_move(Walker &walker, const int particle)
+{   /*
+    Reject the proposed move of 'particle'. Move the particle back so
+    that pos_new equals pos_current for the next proposal.
+
+    Parameters
+    ----------
+    walker : Walker reference
+        The walker which made the move.
+
+    particle : constant integer
+        Index of the moved particle.
+    */
+    walker.pos_new.col(particle) = walker.pos_current.col(particle);
+    walker.qforce_new.col(particle) = walker.qforce_current.col(particle);
+    if constexpr (interaction_t) walker.distances.reject();
+}
+
+template <class Method, int dims, bool interaction_t>
+void VMC::mc_cycle(
+    Method &method,
+    Walker &walker,
+    const double alpha,
+    const int cycle,
+    const bool sample
+)
+{   /*
+    Propose a move for every particle once, and accumulate the
+    observables after each step.
+
+    Parameters
+    ----------
+    method : Method reference
+        The sampling method, which provides metropolis_step.
+
+    walker : Walker reference
+        The walker to advance.
+
+    alpha : constant double
+        Current variational parameter.
+
+    cycle : constant integer
+        Index of this cycle within the burn-in or sampling phase.
+
+    sample : constant boolean
+        Accumulate observables if true. False during burn-in.
+    */
+    int bin;
+    double particle_distance;
+    bool accepted;
+
+    if (incremental_local_energy and (cycle % local_energy_refresh_interval == 0))
+    {   /*
+        Recalculate from scratch now and then to stop round-off from
+        accumulating in the incremental updates.
+        */
+        walker.local_energy_engine.initialize(walker.pos_current, walker.distances, alpha, beta);
+        walker.local_energy = walker.local_energy_engine.get_local_energy();
+    }
+
+    for (int particle = 0; particle < n_particles; particle++)
+    {
+        accepted = method.template metropolis_step<dims, interaction_t>(
+            walker,
+            particle,
+            alpha
+        );
+
+        if (!sample) continue;
+        if (accepted) walker.acceptance++;
+
+        // GD specifics.
+        for (int k = 0; k < n_wave_parameters; k++)
+        {
+            walker.wave_derivative_expectation[k] += walker.wave_derivative[k];
+            walker.wave_times_energy_expectation[k] += walker.wave_derivative[k]*walker.local_energy;
+            for (int l = 0; l < n_wave_parameters; l++)
+            {
+                walker.wave_derivative_products_expectation[k*n_wave_parameters + l] +=
+                    walker.wave_derivative[k]*walker.wave_derivative[l];
+            }
+        }
+        // GD specifics end.
+
+        // One-body density.
+        particle_distance = 0;
+        for (int dim = 0; dim < dims; dim++)
+        {
+            particle_distance += walker.pos_current(dim, particle)*walker.pos_current(dim, particle);
+        }
+        particle_distance = std::sqrt(particle_distance);
+        for (bin = 0; bin < n_bins - 1; bin++)
+        {
+            if (
+                (particle_distance >= bin_locations(bin)) and
+                (particle_distance <  bin_locations(bin + 1))
+            )
+            {
+                walker.particle_per_bin_count(bin) += 1;
+                break;  // No need to continue checking for this particle!
+            }
+        }
+        // One-body density end.
+
+        walker.energy_expectation += walker.local_energy;
+        walker.energy_expectation_squared += walker.local_energy*walker.local_energy;
+    }
+}
+
+template <int dims, bool interaction_t>
+void VMC::reweight_cycle(Walker &walker, const double alpha)
+{   /*
+    Add the current configuration R of a sampled cycle to the
+    correlated sampling sums of every target alpha in reweight_alphas.
+    The weight is |psi_target(R)/psi_alpha(R)|^2 = exp(2 (target -
+    alpha) O), with O = d ln(psi)/d alpha, since the Jastrow factor does
+    not depend on alpha.  The local energy is a quadratic polynomial in
+    alpha for a fixed R, so it is found for all targets from two extra
+    local energy evaluations at alpha +- reweight_step.
+
+    The weights are stored relative to the weight of the first sampled
+    cycle of the walker (row 0), so that they do not overflow for large
+    numbers of particles.  Rows 1 - 4 are the sums of w, w E, w E^2 and
+    w^2.
+
+    Parameters
+    ----------
+    walker : Walker reference
+        The walker, after a sampled cycle.
+
+    alpha : constant double
+        Alpha of the reference chain.
+    */
+    const double energy_plus = local_energy_total<dims, interaction_t>(
+        walker.pos_current,
+        walker.distances,
+        alpha + reweight_step,
+        beta
+    );
+    const double energy_minus = local_energy_total<dims, interaction_t>(
+        walker.pos_current,
+        walker.distances,
+        alpha - reweight_step,
+        beta
+    );
+    const double slope = (energy_plus - energy_minus)/(2*reweight_step);
+    const double curvature = (energy_plus + energy_minus - 2*walker.local_energy)
+        /(2*reweight_step*reweight_step);
+
+    for (arma::uword target = 0; target < reweight_alphas.n_elem; target++)
+    {
+        const double delta = reweight_alphas(target) - alpha;
+        const double log_weight = 2*delta*walker.wave_derivative[0];
+        if (walker.reweight_sums(1, target) == 0) walker.reweight_sums(0, target) = log_weight;
+
+        const double weight = std::exp(log_weight - walker.reweight_sums(0, target));
+        const double energy = walker.local_energy + slope*delta + curvature*delta*delta;
+        walker.reweight_sums(1, target) += weight;
+        walker.reweight_sums(2, target) += weight*energy;
+        walker.reweight_sums(3, target) += weight*energy*energy;
+        walker.reweight_sums(4, target) += weight*weight;
+    }
+}
+
+template <int dims, bool interaction_t>
+void VMC::variance_cycle(Walker &walker, const double alpha)
+{   /*
+    Accumulate the terms of the gradient of the energy variance after a
+    sampled cycle, see one_variation.  The derivatives of the local
+    energy with respect to the optimized parameters are central
+    differences, which are exact since the local energy is a quadratic
+    polynomial in alpha and in beta.
+
+    walker.variance_sums holds the sums of E, E^2 and, per parameter
+    k, of O_k, O_k E, O_k E^2, dE/dk and E dE/dk, with E the local
+    energy and O_k = d ln(psi)/d k.
+
+    Parameters
+    ----------
+    walker : Walker reference
+        The walker, after a sampled cycle.
+
+    alpha : constant double
+        Current variational parameter.
+    */
+    const int K = n_wave_parameters;
+    const double energy = walker.local_energy;
+    walker.variance_sums(0) += energy;
+    walker.variance_sums(1) += energy*energy;
+
+    for (int k = 0; k < n_variance_parameters; k++)
+    {
+        const double alpha_step = (k == 0) ? derivative_step : 0;
+        const double beta_step = (k == 1) ? derivative_step : 0;
+        const double energy_plus = local_energy_total<dims, interaction_t>(
+            walker.pos_current,
+            walker.distances,
+            alpha + alpha_step,
+            beta + beta_step
+        );
+        const double energy_minus = local_energy_total<dims, interaction_t>(
+            walker.pos_current,
+            walker.distances,
+            alpha - alpha_step,
+            beta - beta_step
+        );
+        const double energy_derivative = (energy_plus - energy_minus)/(2*derivative_step);
+        const double wave_derivative = walker.wave_derivative[k];
+
+        walker.variance_sums(2 + k) += wave_derivative;
+        walker.variance_sums(2 + K + k) += wave_derivative*energy;
+        walker.variance_sums(2 + 2*K + k) += wave_derivative*energy*energy;
+        walker.variance_sums(2 + 3*K + k) += energy_derivative;
+        walker.variance_sums(2 + 4*K + k) += energy*energy_derivative;
+    }
+}
+
+template <class Method, int dims, bool interaction_t>
+long VMC::burn_in(Method &method, Walker &walker, const double alpha)
+{   /*
+    Run the burn-in of a freshly initialized walker and return the
+    number of burn-in cycles.  First n_burn_in_cycles cycles are run.
+    With automatic burn-in (set_auto_burn_in), the walker then runs
+    windows of burn_in_window cycles until the mean local energy of a
+    window differs from the mean of the previous window by less than two
+    standard errors, i.e. until the running mean no longer drifts, or
+    until max_burn_in_cycles is reached.  The standard errors ignore the
+    autocorrelation, which makes the test stricter than needed.
+
+    Parameters
+    ----------
+    method : Method reference
+        The sampling method, which provides metropolis_step.
+
+    walker : Walker reference
+        The walker to run.
+
+    alpha : constant double
+        Current variational parameter.
+    */
+    int cycle = 0;
+    for (; cycle < n_burn_in_cycles; cycle++)
+    {
+        mc_cycle<Method, dims, interaction_t>(method, walker, alpha, cycle, false);
+    }
+    if (burn_in_window <= 0) return cycle;
+
+    double previous_mean = 0;
+    double previous_variance = 0;
+    bool previous = false;
+    while (cycle + burn_in_window <= max_burn_in_cycles)
+    {
+        double sum = 0;
+        double sum_squared = 0;
+        for (int window_cycle = 0; window_cycle < burn_in_window; window_cycle++)
+        {
+            mc_cycle<Method, dims, interaction_t>(method, walker, alpha, cycle++, false);
+            sum += walker.local_energy;
+            sum_squared += walker.local_energy*walker.local_energy;
+        }
+        const double mean = sum/burn_in_window;
+        const double variance = std::max(sum_squared/burn_in_window - mean*mean, 0.0);
+
+        if (previous and
+            (std::abs(mean - previous_mean) <= 2*std::sqrt((variance + previous_variance)/burn_in_window)))
+        {
+            break;
+        }
+        previous_mean = mean;
+        previous_variance = variance;
+        previous = true;
+    }
+    return cycle;
+}
+
+template <class Method, int dims, bool interaction_t>
+void VMC::run_walker(
+    Method &method,
+    Walker &walker,
+    const double alpha,
+    const int n_cycles,
+    const bool resume
+)
+{   /*
+    Initialize a walker, run the burn-in and then 'n_cycles' sampled
+    cycles.  With 'resume', the walker instead continues its
+    chain from the previous call, without initialization, burn-in or
+    resetting the accumulators.
+
+    Parameters
+    ----------
+    method : Method reference
+        The sampling method, which provides metropolis_step.
+
+    walker : Walker reference
+        The walker to run. Its RNG must already be seeded.
+
+    alpha : constant double
+        Current variational parameter.
+
+    n_cycles : constant integer
+        Number of sampled MC cycles.
+
+    resume : constant boolean
+        Continue the chain of the previous call if true.
+    */
+    if (!resume)
+    {
+        initialize_walker<dims, interaction_t>(walker, alpha);
+        walker.burn_in_cycles = burn_in<Method, dims, interaction_t>(method, walker, alpha);
+    }
+    for (int cycle = 0; cycle < n_cycles; cycle++)
+    {
+        mc_cycle<Method, dims, interaction_t>(method, walker, alpha, cycle, true);
+        walker.energy_blocking.add(walker.local_energy);
+        if (reweight_alphas.n_elem > 0) reweight_cycle<dims, interaction_t>(walker, alpha);
+        if (n_variance_parameters > 0) variance_cycle<dims, interaction_t>(walker, alpha);
+        if (energy_sink != nullptr) energy_sink->add(walker.id, walker.local_energy);
+    }
+}
+
+template <class Method>
+void VMC::dispatch_walker(
+    Method &method,
+    Walker &walker,
+    const double alpha,
+    const int n_cycles,
+    const bool resume
+)
+{   /*
+    Select the instantiation of run_walker for the number of dimensions
+    and interaction of this run.  set_wave_function and
+    set_quantum_force have already rejected unsupported combinations.
+    See run_walker for parameters.
+    */
+    if (interaction)
+    {
+        run_walker<Method, 3, true>(method, walker, alpha, n_cycles, resume);
+    }
+    else if (n_dims == 1)
+    {
+        run_walker<Method, 1, false>(method, walker, alpha, n_cycles, resume);
+    }
+    else if (n_dims == 2)
+    {
+        run_walker<Method, 2, false>(method, walker, alpha, n_cycles, resume);
+    }
+    else
+    {
+        run_walker<Method, 3, false>(method, walker, alpha, n_cycles, resume);
+    }
+}
+
+#endif
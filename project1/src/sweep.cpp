@@ -0,0 +1,255 @@
+#include "sweep.h"
+#include "methods.h"
+#include "distributed.h"
+#include <algorithm>
+#include <memory>
+
+Sweep::Sweep(
+    const std::string method_input,
+    const int n_dims_input,
+    const int n_mc_cycles_input,
+    const bool interaction_input,
+    const bool numerical_differentiation_input
+) : method(method_input),
+    n_dims(n_dims_input),
+    n_mc_cycles(n_mc_cycles_input),
+    interaction(interaction_input),
+    numerical_differentiation(numerical_differentiation_input)
+{   /*
+    Class constructor.
+
+    Parameters
+    ----------
+    method_input : constant std::string
+        'brute' or 'importance'.
+
+    n_dims_input : constant integer
+        The number of spatial dimensions.
+
+    n_mc_cycles_input : constant integer
+        The number of Monte Carlo cycles per point.
+
+    interaction_input : constant boolean
+        Toggle interaction between particles on / off.
+
+    numerical_differentiation_input : constant boolean
+        Toggle numerical differentiation on / off.
+    */
+    if ((method != "brute") and (method != "importance"))
+    {
+        std::cout << "Sweeps are only implemented for 'brute' and 'importance'. Exiting..." << std::endl;
+        exit(0);
+    }
+}
+
+void Sweep::add_point(
+    const int n_particles,
+    const double alpha,
+    const double beta,
+    const double step
+)
+{   /*
+    Add a point to the sweep.
+
+    Parameters
+    ----------
+    n_particles : constant integer
+        The number of particles.
+
+    alpha : constant double
+        Variational parameter.
+
+    beta : constant double
+        Variational parameter in the z direction.
+
+    step : constant double
+        Brute force step size or importance time step.
+    */
+    SweepPoint point;
+    point.n_particles = n_particles;
+    point.alpha = alpha;
+    point.beta = beta;
+    point.step = step;
+    points.push_back(point);
+}
+
+void Sweep::run_point(SweepPoint &point, const long seed)
+{   /*
+    Run a single point on the calling thread.
+    */
+    arma::Col<double> alphas(1);
+    alphas(0) = point.alpha;
+
+    std::unique_ptr<VMC> system;
+    if (method == "brute")
+    {
+        system = std::make_unique<BruteForce>(
+            n_dims, 1, n_mc_cycles, point.n_particles, alphas, point.beta,
+            point.step, numerical_differentiation, false
+        );
+    }
+    else
+    {
+        system = std::make_unique<ImportanceSampling>(
+            n_dims, 1, n_mc_cycles, point.n_particles, alphas, point.beta,
+            point.step, numerical_differentiation, false
+        );
+    }
+    system->set_wave_function(interaction);
+    system->set_quantum_force(interaction);
+    system->set_local_energy(interaction);
+    system->set_seed(seed);
+    system->set_distributed(false);
+    system->set_n_walkers(n_walkers);
+    system->set_burn_in(n_burn_in_cycles);
+    system->set_auto_burn_in(burn_in_window, max_burn_in_cycles);
+    system->set_target_error(target_error, max_cycles);
+    system->set_verbose(false);
+    system->solve();
+
+    point.energy = system->get_energy(0);
+    point.energy_variance = system->get_energy_variance(0);
+    point.energy_error = system->get_energy_error(0);
+    point.acceptance_rate = system->get_acceptance_rate(0);
+    point.time = system->get_time(0);
+    point.burn_in_cycles = system->get_burn_in_cycles(0);
+}
+
+void Sweep::print_point(const int point) const
+{   /*
+    Print the result of a single point.
+    */
+    std::cout << "point: " << std::setw(4) << point;
+    std::cout << ", N: " << std::setw(4) << points[point].n_particles;
+    std::cout << ", alpha: " << std::setw(8) << points[point].alpha;
+    std::cout << ", beta: " << std::setw(8) << points[point].beta;
+    std::cout << ", step: " << std::setw(8) << points[point].step;
+    std::cout << ", energy: " << std::setw(10) << points[point].energy;
+    std::cout << ", error: " << std::setw(10) << points[point].energy_error;
+    std::cout << ",  time : " << points[point].time << "s" << std::endl;
+}
+
+void Sweep::run(const long seed)
+{   /*
+    Run all points.  Point 'i' uses the seed 'seed + i', so the results
+    do not depend on the number of threads or on which thread ran which
+    point.  The parallel region inside VMC::one_variation is nested and
+    runs on the calling thread only.  In a distributed run, the points
+    are dealt out to the ranks in order of cost, and the results are
+    summed over the ranks afterwards, so every rank has all results.
+
+    Parameters
+    ----------
+    seed : constant long
+        RNG seed of the first point.
+    */
+    const int n_points = points.size();
+
+    #ifdef _OPENMP
+        omp_set_max_active_levels(1);   // Run the walkers of a point on its thread.
+    #endif
+
+    // Most expensive points first. The interaction makes the cost
+    // quadratic in the number of particles.
+    std::vector<int> order(n_points);
+    std::vector<double> cost(n_points);
+    for (int point = 0; point < n_points; point++)
+    {
+        const double n = points[point].n_particles;
+        cost[point] = interaction ? n*n : n;
+        order[point] = point;
+    }
+    std::stable_sort(order.begin(), order.end(),
+        [&cost](const int i, const int j) {return cost[i] > cost[j];});
+
+    std::vector<int> rank_points;
+    for (int index = distributed_rank(); index < n_points; index += distributed_size())
+    {
+        rank_points.push_back(order[index]);
+    }
+    const int n_rank_points = rank_points.size();
+
+    // A single rank prints each point as soon as it is done. Otherwise
+    // the root prints all points once the results are gathered.
+    const bool print_progress = distributed_size() == 1;
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int index = 0; index < n_rank_points; index++)
+    {
+        const int point = rank_points[index];
+        run_point(points[point], seed + point);
+
+        if (print_progress)
+        {
+            #pragma omp critical(sweep_print)
+            print_point(point);
+        }
+    }
+
+    // Results of all ranks. A point is zero on every rank but its own.
+    const int n_results = 6;
+    std::vector<double> results(n_results*n_points, 0);
+    for (const int point : rank_points)
+    {
+        results[n_results*point + 0] = points[point].energy;
+        results[n_results*point + 1] = points[point].energy_variance;
+        results[n_results*point + 2] = points[point].energy_error;
+        results[n_results*point + 3] = points[point].acceptance_rate;
+        results[n_results*point + 4] = points[point].time;
+        results[n_results*point + 5] = points[point].burn_in_cycles;
+    }
+    distributed_sum(results.data(), results.size());
+    for (int point = 0; point < n_points; point++)
+    {
+        points[point].energy = results[n_results*point + 0];
+        points[point].energy_variance = results[n_results*point + 1];
+        points[point].energy_error = results[n_results*point + 2];
+        points[point].acceptance_rate = results[n_results*point + 3];
+        points[point].time = results[n_results*point + 4];
+        points[point].burn_in_cycles = results[n_results*point + 5];
+    }
+
+    if (!print_progress and distributed_root())
+    {
+        for (int point = 0; point < n_points; point++) print_point(point);
+    }
+}
+
+void Sweep::write_to_file(std::string fpath)
+{   /*
+    Write the results of all points to file, one row per point in the
+    order they were added.
+
+    Parameters
+    ----------
+    fpath : std::string
+        Relative file path and name.
+    */
+    std::ofstream outfile(fpath, std::ios::out);
+    outfile << std::setw(20) << "n_particles";
+    outfile << std::setw(21) << "alpha";
+    outfile << std::setw(21) << "beta";
+    outfile << std::setw(21) << "step";
+    outfile << std::setw(21) << "expected_energy";
+    outfile << std::setw(21) << "variance_energy";
+    outfile << std::setw(21) << "blocking_error";
+    outfile << std::setw(21) << "acceptance_rate";
+    outfile << std::setw(21) << "time";
+    outfile << std::setw(21) << "burn_in_cycles\n";
+
+    for (const SweepPoint &point : points)
+    {
+        outfile << std::setw(20) << point.n_particles;
+        outfile << std::setw(20) << std::setprecision(10) << point.alpha;
+        outfile << std::setw(20) << std::setprecision(10) << point.beta;
+        outfile << std::setw(20) << std::setprecision(10) << point.step;
+        outfile << std::setw(20) << std::setprecision(10) << point.energy;
+        outfile << std::setw(20) << std::setprecision(10) << point.energy_variance;
+        outfile << std::setw(20) << std::setprecision(10) << point.energy_error;
+        outfile << std::setw(20) << std::setprecision(10) << point.acceptance_rate;
+        outfile << std::setw(20) << std::setprecision(10) << point.time;
+        outfile << std::setw(20) << static_cast<long>(point.burn_in_cycles) << "\n";
+    }
+    outfile.close();
+    std::cout << fpath << " written to file." << std::endl;
+}
@@ -0,0 +1,72 @@
+#ifndef SWEEP
+#define SWEEP
+
+#include <string>
+#include <vector>
+
+struct SweepPoint
+{   /*
+    One independent calculation of a parameter sweep, and its result.
+    */
+    int n_particles;
+    double alpha;
+    double beta;
+    double step;                // Brute force step size or importance time step.
+
+    double energy = 0;
+    double energy_variance = 0;
+    double energy_error = 0;    // Blocking estimate of the standard error.
+    double acceptance_rate = 0;
+    double time = 0;
+    double burn_in_cycles = 0;  // Discarded MC cycles of all walkers.
+};
+
+class Sweep
+{   /*
+    Run many independent (n_particles, alpha, beta, step) points of a
+    brute force or importance sampling calculation in parallel.  Every
+    point is a separate sampler with its own walkers, run by a single
+    thread, so that small systems do not spend their time in the
+    fork/join and reductions of VMC::one_variation.  The threads take
+    the next point as soon as they are done with one (dynamic
+    scheduling), and the points are started in order of decreasing
+    estimated cost, so that an expensive point is not left for last
+    while the other threads idle.
+    */
+    private:
+        const std::string method;
+        const int n_dims;
+        const int n_mc_cycles;
+        const bool interaction;
+        const bool numerical_differentiation;
+        std::vector<SweepPoint> points;
+
+        void run_point(SweepPoint &point, const long seed);
+        void print_point(const int point) const;
+
+    public:
+        int n_walkers = 1;              // Walkers per point.
+        int n_burn_in_cycles = 1000;    // Discarded MC cycles per walker.
+        int burn_in_window = 0;         // See VMC::set_auto_burn_in.
+        int max_burn_in_cycles = 0;
+        double target_error = 0;        // See VMC::set_target_error.
+        long max_cycles = 0;
+
+        Sweep(
+            const std::string method_input,
+            const int n_dims_input,
+            const int n_mc_cycles_input,
+            const bool interaction_input,
+            const bool numerical_differentiation_input
+        );
+        void add_point(
+            const int n_particles,
+            const double alpha,
+            const double beta,
+            const double step
+        );
+        void run(const long seed);
+        void write_to_file(std::string fpath);
+};
+
+#endif
@@ -0,0 +1,114 @@
+#include "walker.h"
+#include "checkpoint.h"
+
+Walker::Walker(
+    const int id_input,
+    const int n_dims,
+    const int n_particles,
+    const int n_bins,
+    const bool interaction
+) : id(id_input)
+{   /*
+    Class constructor.
+
+    Parameters
+    ----------
+    id_input : constant integer
+        Walker index.
+
+    n_dims : constant integer
+        The number of spatial dimensions.
+
+    n_particles : constant integer
+        The number of particles.
+
+    n_bins : constant integer
+        The number of one-body density bins.
+
+    interaction : constant boolean
+        The distance cache is only allocated with interaction.
+    */
+    pos_current = arma::Mat<double>(n_dims, n_particles);
+    pos_new = arma::Mat<double>(n_dims, n_particles);
+    qforce_current = arma::Mat<double>(n_dims, n_particles);
+    qforce_new = arma::Mat<double>(n_dims, n_particles);
+    if (interaction) distances = DistanceCache(n_particles, n_dims);
+    local_energy_engine = IncrementalLocalEnergy(n_particles);
+    particle_per_bin_count = arma::Col<double>(n_bins);
+
+    pos_current.zeros();
+    pos_new.zeros();
+    qforce_current.zeros();
+    qforce_new.zeros();
+    reset_accumulators();
+}
+
+void Walker::reset_accumulators()
+{   /*
+    Zero all accumulators. Called at the start of every variation.
+    */
+    energy_expectation = 0;
+    energy_expectation_squared = 0;
+    wave_derivative_expectation.fill(0);
+    wave_times_energy_expectation.fill(0);
+    wave_derivative_products_expectation.fill(0);
+    acceptance = 0;
+    particle_per_bin_count.zeros();
+    energy_blocking.reset();
+    reweight_sums.zeros();
+    variance_sums.zeros();
+}
+
+void Walker::save(std::ostream &outfile) const
+{   /*
+    Write the state of the chain to a checkpoint: positions, quantum
+    forces, RNG and accumulators.  Only valid between MC cycles, where
+    pos_new and qforce_new equal pos_current and qforce_current.  The
+    distances and the local energy engine are derived from the
+    positions and are recalculated by load and the next MC cycle.
+    */
+    write_matrix(outfile, pos_current);
+    write_matrix(outfile, qforce_current);
+    write_raw(outfile, random);
+    write_raw(outfile, local_energy);
+    write_raw(outfile, wave_derivative);
+
+    write_raw(outfile, energy_expectation);
+    write_raw(outfile, energy_expectation_squared);
+    write_raw(outfile, wave_derivative_expectation);
+    write_raw(outfile, wave_times_energy_expectation);
+    write_raw(outfile, wave_derivative_products_expectation);
+    write_raw(outfile, acceptance);
+    write_raw(outfile, burn_in_cycles);
+    write_matrix(outfile, particle_per_bin_count);
+    write_raw(outfile, energy_blocking);
+    write_matrix(outfile, reweight_sums);
+    write_matrix(outfile, variance_sums);
+}
+
+void Walker::load(std::istream &infile)
+{   /*
+    Restore the state written by save.
+    */
+    read_matrix(infile, pos_current);
+    read_matrix(infile, qforce_current);
+    read_raw(infile, random);
+    read_raw(infile, local_energy);
+    read_raw(infile, wave_derivative);
+
+    read_raw(infile, energy_expectation);
+    read_raw(infile, energy_expectation_squared);
+    read_raw(infile, wave_derivative_expectation);
+    read_raw(infile, wave_times_energy_expectation);
+    read_raw(infile, wave_derivative_products_expectation);
+    read_raw(infile, acceptance);
+    read_raw(infile, burn_in_cycles);
+    read_matrix(infile, particle_per_bin_count);
+    read_raw(infile, energy_blocking);
+    read_matrix(infile, reweight_sums);
+    read_matrix(infile, variance_sums);
+
+    pos_new = pos_current;
+    qforce_new = qforce_current;
+    distances.compute(pos_current);
+}
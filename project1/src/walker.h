@@ -0,0 +1,65 @@
+#ifndef WALKER
+#define WALKER
+
+#include <armadillo>
+#include <array>
+#include <istream>
+#include <ostream>
+#include "random_buffer.h"
+#include "distance_cache.h"
+#include "incremental_local_energy.h"
+#include "blocking.h"
+
+// Variational parameters alpha and beta, see wave_function_log_derivatives.
+const int n_wave_parameters = 2;
+typedef std::array<double, n_wave_parameters> WaveParameters;
+
+class Walker
+{   /*
+    State of a single, independent Markov chain.  Every walker has its
+    own positions, quantum forces, caches, RNG and accumulators, so that
+    walkers can be run on different threads without sharing anything
+    but read-only parameters.  The accumulators are summed over all
+    walkers after the parallel region.
+    */
+    public:
+        int id;                                 // Walker index. Also selects the RNG stream.
+
+        arma::Mat<double> pos_current;          // Current position.
+        arma::Mat<double> pos_new;              // Proposed new position.
+        arma::Mat<double> qforce_current;       // Current quantum force.
+        arma::Mat<double> qforce_new;           // New quantum force.
+        DistanceCache distances;                // Pairwise distances of pos_current / pos_new.
+        IncrementalLocalEnergy local_energy_engine; // O(N) local energy updates.
+
+        RandomBuffer random;            // Buffered Philox uniforms and normals. One stream per walker.
+
+        double local_energy = 0;        // Local energy of pos_current.
+        WaveParameters wave_derivative = {};    // d ln(psi)/d (alpha, beta) of pos_current.
+
+        // Accumulators.
+        double energy_expectation = 0;
+        double energy_expectation_squared = 0;
+        WaveParameters wave_derivative_expectation = {};
+        WaveParameters wave_times_energy_expectation = {};
+        std::array<double, n_wave_parameters*n_wave_parameters> wave_derivative_products_expectation = {};
+        long acceptance = 0;
+        long burn_in_cycles = 0;                    // Discarded MC cycles of this variation.
+        arma::Col<double> particle_per_bin_count;   // One-body density.
+        BlockingAccumulator energy_blocking;        // Local energy of every sampled cycle.
+        arma::Mat<double> reweight_sums;            // Correlated sampling, one column per target alpha, see VMC::reweight.
+        arma::Col<double> variance_sums;            // Variance objective, see VMC::variance_cycle.
+
+        Walker(
+            const int id_input,
+            const int n_dims,
+            const int n_particles,
+            const int n_bins,
+            const bool interaction
+        );
+        void reset_accumulators();
+        void save(std::ostream &outfile) const;
+        void load(std::istream &infile);
+};
+
+#endif
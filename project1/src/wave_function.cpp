@@ -1,41 +1,5 @@
 #include "wave_function.h"
 
-double wave_function_1d_no_interaction_with_loop(
-    const arma::Mat<double> &pos,
-    double alpha,
-    double beta,
-    const int n_particles
-)
-{   /*
-    Parameters
-    ----------
-    pos : arma::Col<double>
-        Vector of position of all particles. 3xN.
-
-    alpha : double
-        Variational parameter.
-
-    beta : double
-        ??? parameter.
-
-    n_particles : constant integer
-        The total number of particles.
-
-    Returns
-    -------
-    : double
-        The resulting wave function.
-    */
-
-    double res = 0;
-
-    for (int particle = 0; particle < n_particles; particle++)
-    {
-        res += -alpha*pos(0, particle)*pos(0, particle);
-    }
-    return std::exp(res);
-}
-
 autodiff::HigherOrderDual<2> wave_function_1d_no_interaction(
     autodiff::HigherOrderDual<2> &x,
     const struct Params &params
@@ -138,122 +102,27 @@ autodiff::HigherOrderDual<2> wave_function_3d_no_interaction(
     return autodiff::forward::exp(-params.alpha*(x*x + y*y + params.beta*z*z));
 }
 
-double wave_function_2d_no_interaction_with_loop(
-    const arma::Mat<double> &pos,
-    double alpha,
-    double beta,
-    const int n_particles
-)
-{   /*
-    Parameters
-    ----------
-    pos : arma::Col<double>
-        Vector of position of all particles. 3xN.
-
-    alpha : double
-        Variational parameter.
-
-    beta : double
-        ??? parameter.
-
-    n_particles : constant integer
-        The total number of particles.
-
-    Returns
-    -------
-    : double
-        The resulting wave function.
-    */
-
-    double res = 0;
-    double x;
-    double y;
-
-    for (int particle = 0; particle < n_particles; particle++)
-    {   
-        x = pos(0, particle);
-        y = pos(1, particle);
-        res += -alpha*(x*x + y*y);
-    }
-    return std::exp(res);
-}
-
-double wave_function_exponent_3d_no_interaction(
-    const arma::Mat<double> &pos,
-    double alpha,
-    double beta
-)
-{   /*
-    Parameters
-    ----------
-    pos : arma::Col<double>
-        Vector of position of a particle.
-
-    alpha : double
-        Variational parameter.
-
-    beta : double
-        ??? parameter.
-
-    Returns
-    -------
-    : double
-        The resulting wave function exponent.
-    */
-    return -alpha*(pos(0)*pos(0) + pos(1)*pos(1) + beta*pos(2)*pos(2));
-}
-
-double wave_function_3d_no_interaction_with_loop(
-    const arma::Mat<double> &pos,
-    double alpha,
-    double beta,
-    const int n_particles
-    )
-{   /*
-    Parameters
-    ----------
-    pos : arma::Col<double>
-        Vector of position of a particle.
-
-    alpha : double
-        Variational parameter.
-
-    beta : double
-        ??? parameter.
-
-    Returns
-    -------
-    : double
-        The resulting wave function evaluated at pos.
-    */
-
-    double wave_function = 1;
-    for (int particle = 0; particle < n_particles; particle++)
-    {
-        wave_function *= std::exp(-alpha*(
-            pos(0, particle)*pos(0, particle) +
-            pos(1, particle)*pos(1, particle) +
-            pos(2, particle)*pos(2, particle)*beta
-        ));
-    }
-
-    return wave_function;
-}
-
-double wave_function_3d_interaction_with_loop(
+double wave_function_3d_interaction_log(
     const arma::Mat<double> &pos,
+    const DistanceCache &distances,
     double alpha,
     double beta,
     const int n_particles
 )
 {   /*
-    3D wave function with interaction term.
+    Logarithm of the 3D wave function with interaction term.  The wave
+    function itself, a product of N one-body factors and N(N - 1)/2
+    Jastrow factors, under- or overflows for a few hundred particles,
+    while its logarithm does not.
 
     Parameters
     ----------
     pos : arma::Mat<double>
         Position matrix of all particles. 3xN.
 
+    distances : DistanceCache reference
+        Pairwise distances of all particles in 'pos'.
+
     alpha : double
         Variational parameter.
 
@@ -265,12 +134,12 @@ double wave_function_3d_interaction_with_loop(
 
     Returns
     -------
-    wave_function*wave_function_inner : double
-        The total wavefunction.
+    : double
+        ln|psi|. -infinity if any particle spacing is 'a' or less, ie.
+        where the wave function is zero.
     */
-    
-    double wave_function = 0;   // Non-interaction term.
-    double wave_function_inner = 1; // Interaction term.
+    double wave_function = 0;       // Non-interaction term.
+    double wave_function_inner = 0; // Interaction term.
     double particle_distance;       // Condition for the interaction term of the wavefunction.
 
     int particle;       // Index for particle loop.
@@ -287,118 +156,89 @@ double wave_function_3d_interaction_with_loop(
         ));
     }
 
-
     for (particle = 0; particle < n_particles; particle++)
     {   /*
         Interaction term.
         */
         for (particle_inner = particle + 1; particle_inner < n_particles; particle_inner++)
-        {   
-            particle_distance =
-                arma::norm(pos.col(particle) - pos.col(particle_inner));
+        {
+            particle_distance = distances.distance(particle_inner, particle);
 
-            if (particle_distance > a)
+            if (particle_distance <= a)
             {   /*
-                Interaction if the particle spacing is greater than 'a'.
-                If the spacing is 'a' or less, the interaction is 1, but
-                we do not need to state that explicitly (there are
-                invisible ones everywhere!!).
+                The wave function is zero if the spacing is 'a' or less.
                 */
-                wave_function_inner *= 1 - a/particle_distance;
-            }
-            else
-            {
-                wave_function_inner = 0;
-                break;  // Entire term is zero anyway.
+                return -std::numeric_limits<double>::infinity();
             }
+            wave_function_inner += std::log1p(-a/particle_distance);
         }
     }
-    return std::exp(wave_function)*wave_function_inner;
+    return wave_function + wave_function_inner;
 }
 
-double wave_function_3d_diff_wrt_alpha(
-    const arma::Mat<double> &pos,
+double wave_function_3d_interaction_log_ratio(
+    const arma::Mat<double> &pos_new,
+    const arma::Mat<double> &pos_current,
+    const DistanceCache &distances,
     const double alpha,
-    const double beta
+    const double beta,
+    const int current_particle,
+    const int n_particles
 )
 {   /*
-    CORRECTION: This is only the factor in front of the wave function
-    after differentiation. 
-
-    Parameters
-    ----------
-    pos : arma::Col<double>
-        Vector of position of a particle.
-
-    alpha : double
-        Variational parameter.
-
-    beta : double
-        ??? parameter.
-
-    Returns
-    -------
-    : double
-        The wave function differentiated with respect to alpha evaluated
-        at pos divided by the wavefunction.
+    Logarithm of the ratio psi_new/psi_current for the 3D wave function
+    with interaction, when only 'current_particle' has moved.  Only the
+    one-body factor of the moved particle and the N - 1 Jastrow factors
+    f(r_kj) = 1 - a/r_kj involving it differ between the two
+    configurations, so the ratio is O(N) instead of the O(N^2) of
+    evaluating the full wave function twice.  The Jastrow factor ratios
+    are all close to 1, so their product is formed directly and only its
+    logarithm is taken.  See wave_function_no_interaction_log_ratio for
+    parameters.  Returns -infinity if the proposed position overlaps
+    with another particle.
+
+    'distances' must have been updated with DistanceCache::move for
+    'current_particle', so that 'distance' holds the proposed distances
+    and 'distance_previous' the current ones.  The current configuration
+    is assumed to be allowed, ie. all particle spacings are greater than
+    'a'.
     */
-    return -(pos(0)*pos(0) + pos(1)*pos(1) + beta*pos(2)*pos(2));
-}
-
-double wave_function_2d_diff_wrt_alpha(
-    const arma::Mat<double> &pos,
-    const double alpha,
-    const double beta
-)
-{   /*
-    CORRECTION: This is only the factor in front of the wave function
-    after differentiation. 
-
-    Parameters
-    ----------
-    pos : arma::Col<double>
-        Vector of position of a particle.
+    double jastrow_ratio = 1;
+    double min_distance_new = 1;   // Smallest proposed spacing, if below 1.
+    const double *distance_new = distances.distance.colptr(current_particle);
+    const double *distance_current = distances.distance_previous.memptr();
+
+    const double x_new = pos_new(0, current_particle);
+    const double y_new = pos_new(1, current_particle);
+    const double z_new = pos_new(2, current_particle);
+    const double x_current = pos_current(0, current_particle);
+    const double y_current = pos_current(1, current_particle);
+    const double z_current = pos_current(2, current_particle);
+
+    #pragma omp simd reduction(*:jastrow_ratio) reduction(min:min_distance_new)
+    for (int particle = 0; particle < n_particles; particle++)
+    {   /*
+        Branch-free so that the loop vectorizes. The moved particle
+        itself gets spacing 1 in both configurations, ie. a factor 1.
+        */
+        const bool other = (particle != current_particle);
+        const double particle_distance_new = other ? distance_new[particle] : 1;
+        const double particle_distance_current = other ? distance_current[particle] : 1;
 
-    alpha : double
-        Variational parameter.
+        min_distance_new = std::min(min_distance_new, particle_distance_new);
+        jastrow_ratio *= (1 - a/particle_distance_new)/(1 - a/particle_distance_current);
+    }
 
-    beta : double
-        ??? parameter.
+    if (min_distance_new <= a)
+    {   /*
+        The proposed position overlaps with another particle. The new
+        wave function is zero.
+        */
+        return -std::numeric_limits<double>::infinity();
+    }
 
-    Returns
-    -------
-    : double
-        The wave function differentiated with respect to alpha evaluated
-        at pos divided by the wavefunction.
-    */
-    return -(pos(0)*pos(0) + pos(1)*pos(1));
+    return -alpha*(
+        x_new*x_new + y_new*y_new + beta*z_new*z_new -
+        x_current*x_current - y_current*y_current - beta*z_current*z_current
+    ) + std::log(jastrow_ratio);
 }
-
-double wave_function_1d_diff_wrt_alpha(
-    const arma::Mat<double> &pos,
-    const double alpha,
-    const double beta
-)
-{   /*
-    CORRECTION: This is only the factor in front of the wave function
-    after differentiation. 
-
-    Parameters
-    ----------
-    pos : arma::Col<double>
-        Vector of position of a particle.
-
-    alpha : double
-        Variational parameter.
-
-    beta : double
-        ??? parameter.
-
-    Returns
-    -------
-    : double
-        The wave function differentiated with respect to alpha evaluated
-        at pos divided by the wavefunction.
-    */
-    return -pos(0)*pos(0);
-}
\ No newline at end of file
@@ -3,12 +3,7 @@
 
 #include "VMC.h"
 #include "parameters.h"
-double wave_function_1d_no_interaction_with_loop(
-    const arma::Mat<double> &pos,
-    double alpha,
-    double beta,
-    const int n_particles
-);
+#include <limits>
 autodiff::HigherOrderDual<2> wave_function_1d_no_interaction(
     autodiff::HigherOrderDual<2> &x,
     const struct Params &params
@@ -24,42 +19,174 @@ autodiff::HigherOrderDual<2> wave_function_3d_no_interaction(
     autodiff::HigherOrderDual<2> &z,
     const struct Params &params
 );
-double wave_function_2d_no_interaction_with_loop(
-    const arma::Mat<double> &pos,
-    double alpha,
-    double beta,
-    const int n_particles
-);
-double wave_function_exponent_3d_no_interaction(
-    const arma::Mat<double> &pos,
-    double alpha,
-    double beta
-);
-double wave_function_3d_no_interaction_with_loop(
+double wave_function_3d_interaction_log(
     const arma::Mat<double> &pos,
+    const DistanceCache &distances,
     double alpha,
     double beta,
     const int n_particles
 );
-double wave_function_3d_interaction_with_loop(
-    const arma::Mat<double> &pos,
-    double alpha,
-    double beta,
+double wave_function_3d_interaction_log_ratio(
+    const arma::Mat<double> &pos_new,
+    const arma::Mat<double> &pos_current,
+    const DistanceCache &distances,
+    const double alpha,
+    const double beta,
+    const int current_particle,
     const int n_particles
 );
-double wave_function_3d_diff_wrt_alpha(
+template <int n_dims>
+inline double one_body_exponent(const double *r, const double beta)
+{   /*
+    x^2 + y^2 + beta*z^2 for a single particle, truncated to 'n_dims'
+    dimensions.  The one-body factor of the wave function is
+    exp(-alpha*one_body_exponent).
+
+    Parameters
+    ----------
+    r : constant double pointer
+        The 'n_dims' coordinates of the particle.
+
+    beta : constant double
+        Weight of the z coordinate.
+    */
+    double res = 0;
+    for (int dim = 0; dim < n_dims; dim++)
+    {
+        res += ((dim == 2) ? beta : 1)*r[dim]*r[dim];
+    }
+    return res;
+}
+
+template <int n_dims>
+inline double wave_function_no_interaction_log(
     const arma::Mat<double> &pos,
+    const DistanceCache &distances,
     const double alpha,
-    const double beta
-);
-double wave_function_2d_diff_wrt_alpha(
-    const arma::Mat<double> &pos,
+    const double beta,
+    const int n_particles
+)
+{   /*
+    Logarithm of the wave function without interaction.
+
+    Parameters
+    ----------
+    pos : arma::Mat<double> reference
+        Positions of all particles. n_dims x N.
+
+    distances : DistanceCache reference
+        Pairwise distances. Only in use with interaction.
+
+    alpha : constant double
+        Variational parameter.
+
+    beta : constant double
+        ??? parameter.
+
+    n_particles : constant integer
+        The total number of particles.
+
+    Returns
+    -------
+    : double
+        ln|psi|.
+    */
+    double res = 0;
+    for (int particle = 0; particle < n_particles; particle++)
+    {
+        res += -alpha*one_body_exponent<n_dims>(pos.colptr(particle), beta);
+    }
+    return res;
+}
+
+template <int n_dims>
+inline double wave_function_no_interaction_log_ratio(
+    const arma::Mat<double> &pos_new,
+    const arma::Mat<double> &pos_current,
+    const DistanceCache &distances,
     const double alpha,
-    const double beta
-);
-double wave_function_1d_diff_wrt_alpha(
+    const double beta,
+    const int current_particle,
+    const int n_particles
+)
+{   /*
+    Logarithm of the ratio psi_new/psi_current when only
+    'current_particle' has moved. The one-body factors of all other
+    particles cancel, so only the moved particle is evaluated.
+
+    Parameters
+    ----------
+    pos_new : arma::Mat<double> reference
+        Positions of all particles, where only column 'current_particle'
+        is read (the proposed position).
+
+    pos_current : arma::Mat<double> reference
+        Current positions of all particles.
+
+    distances : DistanceCache reference
+        Pairwise distances. Only in use with interaction.
+
+    alpha : constant double
+        Variational parameter.
+
+    beta : constant double
+        ??? parameter.
+
+    current_particle : constant integer
+        The index of the moved particle.
+
+    n_particles : constant integer
+        The total number of particles.
+
+    Returns
+    -------
+    : double
+        ln(psi_new/psi_current).
+    */
+    return -alpha*(
+        one_body_exponent<n_dims>(pos_new.colptr(current_particle), beta) -
+        one_body_exponent<n_dims>(pos_current.colptr(current_particle), beta)
+    );
+}
+
+template <int n_dims>
+inline WaveParameters wave_function_log_derivatives(
     const arma::Mat<double> &pos,
+    const int current_particle,
     const double alpha,
     const double beta
-);
+)
+{   /*
+    The contribution of 'current_particle' to the log derivatives
+    d ln(psi)/d alpha = -(x^2 + y^2 + beta z^2) and d ln(psi)/d beta =
+    -alpha z^2.  The Jastrow factor depends on neither, so this is the
+    same with and without interaction.  Summed over all particles, this
+    is the wave function differentiated with respect to the variational
+    parameters divided by the wave function.
+
+    Parameters
+    ----------
+    pos : arma::Mat<double> reference
+        Positions of all particles.
+
+    current_particle : constant integer
+        The index of the particle.
+
+    alpha : constant double
+        Variational parameter.
+
+    beta : constant double
+        Variational parameter in the z direction.
+
+    Returns
+    -------
+    : WaveParameters
+        The log derivatives with respect to alpha and beta.
+    */
+    const double *r = pos.colptr(current_particle);
+    WaveParameters derivatives;
+    derivatives[0] = -one_body_exponent<n_dims>(r, beta);
+    derivatives[1] = (n_dims == 3) ? -alpha*r[2]*r[2] : 0;
+    return derivatives;
+}
 #endif